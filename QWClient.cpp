@@ -39,6 +39,16 @@ void QWClient::run()
 	myImplementation->run();
 }
 
+void QWClient::runUntil(int msecs)
+{
+	myImplementation->runUntil(msecs);
+}
+
+int QWClient::nextDeadline() const
+{
+	return myImplementation->nextDeadline();
+}
+
 void QWClient::disconnect()
 {
   myImplementation->disconnect();
@@ -85,6 +95,206 @@ void QWClient::stripColor(char *string)
 	QWClientPrivate::stripColor(string);
 }
 
+const QWClient::MessageStats& QWClient::messageStats(quint8 svc) const
+{
+	return myImplementation->messageStats(svc);
+}
+
+void QWClient::resetMessageStats()
+{
+	myImplementation->resetMessageStats();
+}
+
+void QWClient::setMessageTiming(bool enabled)
+{
+	myImplementation->setMessageTiming(enabled);
+}
+
+void QWClient::setAllocationCounter(const quint64 *counter)
+{
+	myImplementation->setAllocationCounter(counter);
+}
+
+const char* QWClient::messageName(quint8 svc)
+{
+	return QWClientPrivate::messageName(svc);
+}
+
+void QWClient::setMessageInterest(quint8 svc, bool interested)
+{
+	myImplementation->setMessageInterest(svc, interested);
+}
+
+bool QWClient::messageInterest(quint8 svc) const
+{
+	return myImplementation->messageInterest(svc);
+}
+
+bool QWClient::messageSkippable(quint8 svc)
+{
+	return QWClientPrivate::messageSkippable(svc);
+}
+
+void QWClient::replay(const char *data, int size)
+{
+	myImplementation->replay(data, size);
+}
+
+bool QWClient::setCaptureFile(const char *fileName)
+{
+	return myImplementation->setCaptureFile(QString(fileName));
+}
+
+int QWClient::entityCount() const
+{
+	return myImplementation->entityCount();
+}
+
+QWClient::EntityState QWClient::entity(int index) const
+{
+	return myImplementation->entity(index);
+}
+
+const QWEntityStore& QWClient::entityStore() const
+{
+	return myImplementation->entityStore();
+}
+
+QWClient::EntityState QWClient::baseline(int number) const
+{
+	return myImplementation->baseline(number);
+}
+
+const QWClient::PlayerState& QWClient::playerState(int playerNum) const
+{
+	return myImplementation->playerState(playerNum);
+}
+
+const QWSpatialIndex& QWClient::spatialIndex() const
+{
+	return myImplementation->spatialIndex();
+}
+
+void QWClient::setPositionHistory(int snapshots)
+{
+	myImplementation->setPositionHistory(snapshots);
+}
+
+qint64 QWClient::clock() const
+{
+	return myImplementation->clock();
+}
+
+bool QWClient::playerPositionAt(int playerNum, qint64 time, float *origin) const
+{
+	return myImplementation->playerPositionAt(playerNum, time, origin);
+}
+
+bool QWClient::entityPositionAt(int number, qint64 time, float *origin) const
+{
+	return myImplementation->entityPositionAt(number, time, origin);
+}
+
+const QWClient::ScoreboardEntry& QWClient::scoreboard(int playerNum) const
+{
+	return myImplementation->scoreboard(playerNum);
+}
+
+quint32 QWClient::scoreboardChanges() const
+{
+	return myImplementation->scoreboardChanges();
+}
+
+void QWClient::clearScoreboardChanges()
+{
+	myImplementation->clearScoreboardChanges();
+}
+
+QString QWClient::serverInfo(const QString &key) const
+{
+	return myImplementation->serverInfo(key);
+}
+
+const QWInfo& QWClient::serverInfo() const
+{
+	return myImplementation->serverInfo();
+}
+
+const QWInfo& QWClient::userInfo(int playerNum) const
+{
+	return myImplementation->userInfo(playerNum);
+}
+
+const int* QWClient::stats() const
+{
+	return myImplementation->stats();
+}
+
+quint32 QWClient::statChanges() const
+{
+	return myImplementation->statChanges();
+}
+
+void QWClient::clearStatChanges()
+{
+	myImplementation->clearStatChanges();
+}
+
+void QWClient::setSnapshotPublishing(bool enabled)
+{
+	myImplementation->setSnapshotPublishing(enabled);
+}
+
+QWWorldSnapshot QWClient::snapshot() const
+{
+	return myImplementation->snapshot();
+}
+
+int QWClient::projectileCount() const
+{
+	return myImplementation->projectileCount();
+}
+
+const QWClient::Projectile* QWClient::projectiles() const
+{
+	return myImplementation->projectiles();
+}
+
+int QWClient::tempEntityCount() const
+{
+	return myImplementation->tempEntityCount();
+}
+
+const QWClient::TempEntity* QWClient::tempEntities() const
+{
+	return myImplementation->tempEntities();
+}
+
+void QWClient::setEventBatching(bool enabled)
+{
+	myImplementation->setEventBatching(enabled);
+}
+
+bool QWClient::eventBatching() const
+{
+	return myImplementation->eventBatching();
+}
+
+void QWClient::setEventQueue(QWEventQueue *queue)
+{
+	myImplementation->setEventQueue(queue);
+}
+
+int QWClient::staticEntityCount() const
+{
+	return myImplementation->staticEntityCount();
+}
+
+QWClient::EntityState QWClient::staticEntity(int index) const
+{
+	return myImplementation->staticEntity(index);
+}
+
 void QWClient::sendCmd(const char *cmd)
 {
 	QString command(cmd);
@@ -96,6 +306,11 @@ void QWClient::setRate(quint16 rate)
 	myImplementation->setRate(rate);
 }
 
+void QWClient::setReceiveBufferSize(int bytes)
+{
+	myImplementation->setReceiveBufferSize(bytes);
+}
+
 void QWClient::setPing(quint16 ping)
 {
 	myImplementation->setPing(ping);
@@ -123,6 +338,26 @@ QWClient::ClientState QWClient::state() const
 	return myImplementation->state();
 }
 
+int QWClient::packetsDrained() const
+{
+	return myImplementation->packetsDrained();
+}
+
+int QWClient::packetsDropped() const
+{
+	return myImplementation->packetsDropped();
+}
+
+quint32 QWClient::sendBackpressure() const
+{
+	return myImplementation->sendBackpressure();
+}
+
+quint32 QWClient::sendErrors() const
+{
+	return myImplementation->sendErrors();
+}
+
 const QString& QWClient::gameDir() const
 {
   return myImplementation->gameDir();
@@ -196,11 +431,26 @@ void QWClient::onPlayerInfo(int, float, float, float)
 
 }
 
+void QWClient::onPlayerState(const PlayerState&)
+{
+
+}
+
 void QWClient::onPlaySound(int)
 {
 
 }
 
+void QWClient::onTempEntities(const TempEntity*, int)
+{
+
+}
+
+void QWClient::onEvents(const Event*, int)
+{
+
+}
+
 void QWClient::onPrint(int, const char *)
 {
 
@@ -22,16 +22,130 @@ along with this program.  If not, see < http://www.gnu.org/licenses/ >.
 
 #include "qwclient_global.h"
 
+class QWEntityStore;
+class QWSpatialIndex;
+class QWWorldSnapshot;
+class QWEventQueue;
+class QWInfo;
+
 class QWCLIENTSHARED_EXPORT QWClient {
 	friend class QWClientPrivate;
+	friend class QWClientPool;
 public:
   enum ClientState { DisconnectedState, ConnectingState, ConnectedState, LastState };
 
+	/* Parse statistics for one svc message type */
+	struct MessageStats
+	{
+		quint64 count;	//messages parsed
+		quint64 bytes;	//bytes consumed including the svc byte
+		quint64 nsecs;	//time spent parsing, only while message timing is enabled
+		quint64 allocations; //allocations made while parsing, only while message timing is enabled with an allocation counter
+	};
+
+	/* One entity of the last complete packet entities frame */
+	struct EntityState
+	{
+		int		number;		//edict index
+		float	origin[3];
+		float	angles[3];
+		int		modelIndex;
+		int		frame;
+		int		colorMap;
+		int		skinNum;
+		int		effects;
+	};
+
+	/* Last svc_playerinfo received for a player slot */
+	struct PlayerState
+	{
+		int		number;				//player slot
+		bool	active;				//false until the first playerinfo of the level
+		quint32	sequence;			//incoming sequence the state arrived in
+		int		flags;				//PF_* bits
+		int		frame;
+		int		msec;					//age of the state on the server
+		float	origin[3];
+		float	velocity[3];
+		float	viewAngles[3];		//from the player's last command
+		int		forwardMove;
+		int		sideMove;
+		int		upMove;
+		int		buttons;
+		int		impulse;
+		int		commandMsec;
+		int		modelIndex;
+		int		skinNum;
+		int		effects;
+		int		weaponFrame;
+	};
+
+	/* Scoreboard line of a player slot */
+	struct ScoreboardEntry
+	{
+		int		number;				//player slot
+		bool	active;				//the slot has a userinfo
+		bool	spectator;
+		int		userID;
+		int		frags;
+		int		ping;
+		int		pl;
+		qint64	enterTime;		//clock() when the player entered the server
+		char	name[32];
+		char	team[16];
+		int		topColor;
+		int		bottomColor;
+	};
+
+	/* Stats of the tracked player, same indices as svc_updatestat */
+	enum StatIndex { StatHealth, StatFrags, StatWeapon, StatAmmo, StatArmor, StatWeaponFrame, StatShells, StatNails, StatRockets,
+									 StatCells, StatActiveWeapon, StatTotalSecrets, StatTotalMonsters, StatSecrets, StatMonsters, StatItems,
+									 StatViewHeight, StatCount = 32 };
+
+	/* Nail projectile from svc_nails or svc_nails2 */
+	struct Projectile
+	{
+		int		index;				//svc_nails2 projectile number, -1 for svc_nails
+		float	origin[3];
+		float	angles[2];		//pitch and yaw
+	};
+
+	/* svc_temp_entity types, same values as on the wire */
+	enum TempEntityType { TempSpike, TempSuperSpike, TempGunshot, TempExplosion, TempTarExplosion, TempLightning1, TempLightning2,
+												TempWizSpike, TempKnightSpike, TempLightning3, TempLavaSplash, TempTeleport, TempBlood, TempLightningBlood };
+
+	/* One svc_temp_entity */
+	struct TempEntity
+	{
+		quint8	type;				//TempEntityType
+		quint8	count;			//particles of gunshots and blood
+		quint16	entity;			//owner of lightning beams
+		float		origin[3];	//start of lightning beams
+		float		end[3];			//lightning beams only
+	};
+
+	/* Callbacks recorded instead of called while event batching is enabled */
+	enum EventType { PrintEvent, CenterPrintEvent, StuffedCmdEvent, DamageEvent, SoundEvent, FragsEvent, PingEvent, PacketLossEvent,
+									 UserInfoEvent, SetInfoEvent, ServerInfoEvent, PlayerInfoEvent, MaxSpeedEvent, EntGravityEvent, PauseEvent };
+
+	struct Event
+	{
+		quint8			type;				//EventType
+		quint8			playerNum;
+		int					value;			//print level, armor, sound, frags, ping, pl, user id or paused
+		int					value2;			//blood
+		float				vector[3];	//player and sound origins, damage source, max speed and entity gravity in [0]
+		const char*	text;				//message, command, userinfo or info key, only valid during onEvents()
+		const char*	text2;			//info value
+	};
+
 	QWClient();
 	virtual ~QWClient();
 
   void connect(const char* host, quint16 port);
   void run();
+	void runUntil(int msecs); //runs for msecs sleeping between packets and deadlines, returns early on disconnect
+	int nextDeadline() const; //msecs until run() has to send, resend or time out, -1 when disconnected
   void disconnect();
 	void observe();
 	void join();
@@ -41,6 +155,7 @@ public:
 	void setSpectator(bool spectate = true);
 	void setPing(quint16 ping);
 	void setRate(quint16 rate);
+	void setReceiveBufferSize(int bytes);
   void setPassword(const char* password);
 	void sendCmd(const char* cmd);
   const QString& gameDir() const;
@@ -49,9 +164,54 @@ public:
 	const char* host() const;
 	quint16 port() const;
   ClientState state() const;
+	int packetsDrained() const; //datagrams read by the last run()
+	int packetsDropped() const; //datagrams lost by the last run() (socket overflow or truncation)
+	quint32 sendBackpressure() const; //datagrams not sent because the socket buffer was full
+	quint32 sendErrors() const; //datagrams not sent for any other reason
 
 	static void stripColor(char* string);
 
+	const MessageStats& messageStats(quint8 svc) const;
+	void resetMessageStats();
+	void setMessageTiming(bool enabled = true); //costs a clock read per message
+	void setAllocationCounter(const quint64* counter); //sampled around every timed message, for benchmarks counting their allocations
+	static const char* messageName(quint8 svc); //NULL for unknown messages
+	void setMessageInterest(quint8 svc, bool interested); //uninteresting messages are skipped without decoding or callbacks
+	bool messageInterest(quint8 svc) const;
+	static bool messageSkippable(quint8 svc); //messages needed to stay connected are always parsed
+	void replay(const char* data, int size); //parses a server datagram as if it had just been received
+	bool setCaptureFile(const char* fileName); //records received datagrams as [quint32 LE size][data], NULL stops
+	int entityCount() const; //entities in the last complete frame, 0 until one arrives
+	EntityState entity(int index) const; //sorted by entity number
+	const QWEntityStore& entityStore() const; //the entities of entity() as separate arrays for bulk scans
+	EntityState baseline(int number) const; //state new entities are delta'd from
+	const PlayerState& playerState(int playerNum) const; //0 to 31, an empty state otherwise
+	const QWSpatialIndex& spatialIndex() const; //last known player positions and the entities of entity()
+	void setPositionHistory(int snapshots); //positions kept per player and entity for positionAt queries, 0 disables
+	qint64 clock() const; //msecs, the time base of the position history
+	bool playerPositionAt(int playerNum, qint64 time, float* origin) const; //interpolated, or extrapolated up to 100 msecs ahead
+	bool entityPositionAt(int number, qint64 time, float* origin) const;
+	const ScoreboardEntry& scoreboard(int playerNum) const; //0 to 31, an empty entry otherwise
+	quint32 scoreboardChanges() const; //bit per player slot whose scoreboard line changed since the last clearScoreboardChanges()
+	void clearScoreboardChanges();
+	QString serverInfo(const QString& key) const;
+	const QWInfo& serverInfo() const; //parsed serverinfo, keys interned
+	const int* stats() const; //StatCount stats of the player the server tracks for us, ourselves or the spectated player
+	quint32 statChanges() const; //bit per stat index changed since the last clearStatChanges()
+	void clearStatChanges();
+	const QWInfo& userInfo(int playerNum) const; //parsed userinfo, 0 to 31, empty otherwise
+	void setSnapshotPublishing(bool enabled = true); //publish a QWWorldSnapshot after every server message
+	QWWorldSnapshot snapshot() const; //last published snapshot, safe to call from any thread
+	int projectileCount() const; //nails of the last server message
+	const Projectile* projectiles() const;
+	int tempEntityCount() const; //temp entities of the last server message
+	const TempEntity* tempEntities() const;
+	void setEventBatching(bool enabled = true); //deliver gameplay callbacks as one onEvents() per datagram, onTempEntities() is already one call and stays as is
+	bool eventBatching() const;
+	void setEventQueue(QWEventQueue* queue); //enables event batching, events are pushed to the queue instead of onEvents(), NULL detaches; temp entities don't fit a queue record and still go to onTempEntities() on the thread calling run()
+	int staticEntityCount() const;
+	EntityState staticEntity(int index) const;
+
 protected:
 	/* Overridable functions */
 	virtual void onChallenge();
@@ -69,6 +229,8 @@ protected:
 	virtual void onDamage(int armor, int blood);
 	virtual void onLevelChanged(int playerNum, const char* levelName, float gravity, float stopSpeed, float maxSpeed, float spectatorMaxSpeed, float accelerate, float airAccelerate, float waterAccelerate, float friction, float waterFriction, float entGravity);
 	virtual void onPlaySound(int soundNum);
+	virtual void onTempEntities(const TempEntity* events, int count); //all temp entities of a server message, after it is parsed, on the thread calling run() even with an event queue
+	virtual void onEvents(const Event* events, int count); //with event batching, in message order after the datagram is parsed
 	virtual void onUpdateFrags(int playerNum, int frags);
 	virtual void onUpdatePing(int playerNum, int ping);
 	virtual void onUpdatePL(int playerNum, int pl);
@@ -79,6 +241,7 @@ protected:
 	virtual void onEntGravityChange(float entGravity);
 	virtual void onSetPause(bool paused);
 	virtual void onPlayerInfo(int playerNum, float x, float y, float z);
+	virtual void onPlayerState(const PlayerState& state); //the whole playerinfo, called after onPlayerInfo
 	virtual void onError(const char* description);
 	virtual void onOOBPrint(const char* msg);
 	virtual void onOOBCommand(const char* command);
@@ -0,0 +1,248 @@
+/*
+GNU General Public License version 3 notice
+
+Copyright (C) 2012 Mihawk <luiz@netdome.biz>. All rights reserved.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see < http://www.gnu.org/licenses/ >.
+*/
+
+#include "QWClientPool.h"
+#include "QWClient.h"
+#include "QWClientPrivate.h"
+#include <QUdpSocket>
+
+#ifdef Q_OS_LINUX
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
+
+QWClientPool::QWClientPool():
+	myEpollFd(-1),
+	myIteration(0),
+	myReadyCount(0),
+	myBatchedSendFlag(false)
+{
+#ifdef Q_OS_LINUX
+	myEpollFd = epoll_create1(EPOLL_CLOEXEC);
+#endif
+	myClock.start();
+}
+
+QWClientPool::~QWClientPool()
+{
+	while(!myClients.isEmpty())
+		remove(myClients.last()->myClient);
+
+#ifdef Q_OS_LINUX
+	if(myEpollFd != -1)
+		close(myEpollFd);
+#endif
+}
+
+bool QWClientPool::add(QWClient *client)
+{
+	QWClientPrivate* d = client->myImplementation;
+	if(d->myPool)
+		return false;
+
+	d->myPool = this;
+	d->myPoolFd = -1;
+	d->myPoolDeadline = -1;
+	myClients.push_back(d);
+	socketChanged(d);
+	return true;
+}
+
+void QWClientPool::remove(QWClient *client)
+{
+	QWClientPrivate* d = client->myImplementation;
+	if(d->myPool != this)
+		return;
+
+	unschedule(d);
+#ifdef Q_OS_LINUX
+	if(d->myPoolFd != -1)
+		epoll_ctl(myEpollFd, EPOLL_CTL_DEL, d->myPoolFd, NULL);
+#endif
+	if(myPendingSends.removeAll(d))
+	{
+		d->mySendPending = false;
+		d->flushSendQueue();
+	}
+	d->myPoolFd = -1;
+	d->myPool = NULL;
+	myClients.removeAll(d);
+
+	/* Don't touch it if it was already reported ready in this run() */
+	for(int i = 0; i < myReadyCount; ++i)
+	{
+		if(myReadyClients[i] == d)
+			myReadyClients[i] = NULL;
+	}
+}
+
+void QWClientPool::setBatchedSend(bool batched)
+{
+	if(!batched)
+		flushSends();
+	myBatchedSendFlag = batched;
+}
+
+bool QWClientPool::batchedSend() const
+{
+	return myBatchedSendFlag;
+}
+
+void QWClientPool::queueSend(QWClientPrivate *client)
+{
+	/* A client flushing its full queue itself is still listed */
+	if(client->mySendPending)
+		return;
+	client->mySendPending = true;
+	myPendingSends.push_back(client);
+}
+
+void QWClientPool::flushSends()
+{
+	for(int i = 0; i < myPendingSends.size(); ++i)
+	{
+		myPendingSends.at(i)->mySendPending = false;
+		myPendingSends.at(i)->flushSendQueue();
+	}
+	myPendingSends.clear();
+}
+
+int QWClientPool::count() const
+{
+	return myClients.size();
+}
+
+void QWClientPool::socketChanged(QWClientPrivate *client)
+{
+#ifdef Q_OS_LINUX
+	/* The old descriptor may already be closed, in which case the kernel dropped it for us */
+	if(client->myPoolFd != -1)
+		epoll_ctl(myEpollFd, EPOLL_CTL_DEL, client->myPoolFd, NULL);
+	client->myPoolFd = -1;
+
+	if(client->mySocket->isOpen())
+	{
+		struct epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.ptr = client;
+		int fd = client->mySocket->socketDescriptor();
+		if(epoll_ctl(myEpollFd, EPOLL_CTL_ADD, fd, &ev) == 0)
+			client->myPoolFd = fd;
+	}
+#endif
+	schedule(client);
+}
+
+void QWClientPool::schedule(QWClientPrivate *client)
+{
+	unschedule(client);
+
+	int msecs = client->nextDeadline();
+	if(msecs < 0)
+		return;
+
+	client->myPoolDeadline = myClock.elapsed() + msecs;
+	myDeadlines.insert(client->myPoolDeadline, client);
+}
+
+void QWClientPool::unschedule(QWClientPrivate *client)
+{
+	if(client->myPoolDeadline == -1)
+		return;
+
+	myDeadlines.remove(client->myPoolDeadline, client);
+	client->myPoolDeadline = -1;
+}
+
+bool QWClientPool::service(QWClientPrivate *client)
+{
+	/* A client can be both readable and due, run it once */
+	if(client->myPoolIteration == myIteration)
+		return false;
+	client->myPoolIteration = myIteration;
+
+	client->run();
+	if(client->myPool == this)
+		schedule(client);
+	return true;
+}
+
+int QWClientPool::run(int timeout)
+{
+	int serviced = 0;
+	myIteration++;
+
+#ifdef Q_OS_LINUX
+	int wait = timeout;
+	if(!myDeadlines.isEmpty())
+	{
+		qint64 due = qMax<qint64>(0, myDeadlines.firstKey() - myClock.elapsed());
+		if(wait < 0 || due < wait)
+			wait = due;
+	}
+
+	struct epoll_event events[MaxEvents];
+	int count = epoll_wait(myEpollFd, events, MaxEvents, wait);
+
+	/* Sampled before servicing, deadlines set while servicing belong to the next iteration */
+	qint64 now = myClock.elapsed();
+
+	myReadyCount = qMax(count, 0);
+	for(int i = 0; i < myReadyCount; ++i)
+		myReadyClients[i] = events[i].data.ptr;
+
+	for(int i = 0; i < myReadyCount; ++i)
+	{
+		if(myReadyClients[i] && service(static_cast<QWClientPrivate*>(myReadyClients[i])))
+			serviced++;
+	}
+	myReadyCount = 0;
+
+	/* Clients with nothing to read still have to send or time out */
+	QMultiMap<qint64, QWClientPrivate*>::iterator due = myDeadlines.begin();
+	while(due != myDeadlines.end() && due.key() <= now)
+	{
+		/* Already ran as readable, it keeps its new deadline for the next iteration */
+		QWClientPrivate* client = due.value();
+		if(client->myPoolIteration == myIteration)
+		{
+			++due;
+			continue;
+		}
+
+		unschedule(client);
+		if(service(client))
+			serviced++;
+		due = myDeadlines.begin();
+	}
+#else
+	Q_UNUSED(timeout);
+
+	/* No readiness notification here, every client gets polled */
+	QList<QWClientPrivate*> clients = myClients;
+	for(int i = 0; i < clients.size(); ++i)
+	{
+		if(service(clients.at(i)))
+			serviced++;
+	}
+#endif
+
+	flushSends();
+	return serviced;
+}
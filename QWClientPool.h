@@ -0,0 +1,97 @@
+/*
+GNU General Public License version 3 notice
+
+Copyright (C) 2012 Mihawk <luiz@netdome.biz>. All rights reserved.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see < http://www.gnu.org/licenses/ >.
+*/
+
+#ifndef QWCLIENTPOOL_H
+#define QWCLIENTPOOL_H
+
+#include "qwclient_global.h"
+#include <QElapsedTimer>
+#include <QList>
+#include <QMultiMap>
+
+class QWClient;
+class QWClientPrivate;
+
+/**
+  Drives many QWClient instances from a single thread.
+
+  Instead of calling run() on every client in a busy loop, add the clients
+  to a pool and call the pool's run(). It sleeps in the kernel (epoll on
+  Linux) until one of the sockets has data or a client has to send
+  something, and only runs the clients that need it.
+*/
+class QWCLIENTSHARED_EXPORT QWClientPool
+{
+	friend class QWClientPrivate;
+public:
+	QWClientPool();
+	~QWClientPool();
+
+	/**
+		Adds a client to the pool. A client can only belong to one pool.
+
+		@param	client The client to be driven by this pool
+		@return	False if the client already belongs to a pool
+	*/
+	bool	add(QWClient* client);
+	void	remove(QWClient* client);
+	int		count() const;
+
+	/**
+		Waits for socket activity or the next client deadline and runs the
+		clients that are ready.
+
+		@param	timeout Maximum time to wait in msecs, -1 waits until the next deadline
+		@return	The number of clients that were run
+	*/
+	int		run(int timeout = -1);
+
+	/**
+		When enabled, datagrams sent by the clients during run() are queued and
+		written with one sendmmsg() per client after all of them had their
+		turn, so sending never gets in between reading and parsing.
+	*/
+	void	setBatchedSend(bool batched);
+	bool	batchedSend() const;
+
+private:
+	enum { MaxEvents = 256 };
+
+	int												myEpollFd;
+	QElapsedTimer							myClock;
+	quint32										myIteration;
+	QList<QWClientPrivate*>		myClients;
+	QMultiMap<qint64, QWClientPrivate*> myDeadlines;	//absolute msecs on myClock
+
+	/* Pending epoll results, cleared when a client leaves during run() */
+	void*											myReadyClients[MaxEvents];
+	int												myReadyCount;
+
+	bool											myBatchedSendFlag;
+	QList<QWClientPrivate*>		myPendingSends;
+
+	void	socketChanged(QWClientPrivate* client);
+	void	schedule(QWClientPrivate* client);
+	void	unschedule(QWClientPrivate* client);
+	bool	service(QWClientPrivate* client);
+	void	queueSend(QWClientPrivate* client);
+	void	flushSends();
+};
+
+#endif // QWCLIENTPOOL_H
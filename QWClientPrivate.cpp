@@ -21,8 +21,10 @@ along with this program.  If not, see < http://www.gnu.org/licenses/ >.
 #include "QWClientPrivate.h"
 #include "QWPack.h"
 #include "QWTables.h"
+#include "QWClientPool.h"
 #include <QUdpSocket>
 #include <QTime>
+#include <QElapsedTimer>
 #include <QBuffer>
 #include <QFile>
 #include <QDir>
@@ -35,6 +37,12 @@ along with this program.  If not, see < http://www.gnu.org/licenses/ >.
 #include <QtEndian>
 #include <QRegExp>
 #include <QDebug>
+#include <stdlib.h>
+
+#ifdef Q_OS_LINUX
+#include <sys/socket.h>
+#include <errno.h>
+#endif
 
 const char* QWClientPrivate::ClientName		= "libqwclient";
 const char* QWClientPrivate::ClientVersion = "0.1";
@@ -45,12 +53,36 @@ QWClientPrivate::QWClientPrivate(QWClient* client):
     myTime(new QTime),
     myLastServerReplyTime(new QTime),
     myDownload(new QFile),
+    myInBegin(NULL),
+    myInCursor(NULL),
+    myInEnd(NULL),
+    myCaptureFile(NULL),
+    myReplayFlag(false),
+    myPacketsDrained(0),
+    myPacketsDropped(0),
+    myKernelDropCount(0),
+    myReceiveBufferSize(0),
+    myPool(NULL),
+    myPoolFd(-1),
+    myPoolDeadline(-1),
+    myPoolIteration(0),
+    mySendQueueCount(0),
+    mySendPending(false),
+    mySendBackpressure(0),
+    mySendErrors(0),
     myClientName(ClientName),
     myClientVersion(ClientVersion),
     myState(QWClient::DisconnectedState),
     myGameDir("qw"),
     myQuakeDir(QCoreApplication::applicationDirPath()),
     myPing(666),
+    myProjectileCount(0),
+    myTempEntityCount(0),
+    myBatchEventsFlag(false),
+    myEventQueue(NULL),
+    myScoreboardChanges(0),
+    myStatChanges(0),
+    myPublishSnapshotsFlag(false),
     myRate(3000),
     myTopColor(0),
     myBottomColor(0),
@@ -58,13 +90,19 @@ QWClientPrivate::QWClientPrivate(QWClient* client):
     mySpectatorFlag(true),
     myTeam("lqwc"),
     _mapChecksum(0),
-    myWrongChecksumFlag(false)
+    myWrongChecksumFlag(false),
+    myMessageTimingFlag(false),
+    myAllocationCounter(NULL)
 {
     /* Setup IO streams */
-    myInBuffer.setBuffer(&myInData);
-    myInStream.setDevice(&myInBuffer);
-    myInStream.setByteOrder(QDataStream::LittleEndian);
-    myInBuffer.open(QIODevice::ReadOnly);
+    myRecvRing.resize(RecvBatchSize * RecvSlotSize);
+    mySendQueue.reserve(SendQueueSize * MAX_MSGLEN);
+    myEvents.reserve(64);
+
+    resetMessageStats();
+    myClock.start();
+    memset(myIgnoredMessages, 0, sizeof(myIgnoredMessages));
+    resetNetchan();
 
     myUnreliableOutBuffer.setBuffer(&myUnreliableOutData);
     myUnreliableOutStream.setDevice(&myUnreliableOutBuffer);
@@ -104,6 +142,25 @@ void QWClientPrivate::setRate(quint16 rate)
     sendCmd("setinfo \"rate\" \"" + QString::number(rate) + "\"");
 }
 
+void QWClientPrivate::setReceiveBufferSize(int bytes)
+{
+    myReceiveBufferSize = bytes;
+    if(mySocket->isOpen())
+        setupSocketOptions();
+}
+
+void QWClientPrivate::setupSocketOptions()
+{
+    if(myReceiveBufferSize > 0)
+        mySocket->setSocketOption(QAbstractSocket::ReceiveBufferSizeSocketOption, myReceiveBufferSize);
+
+#ifdef Q_OS_LINUX
+    /* Have the kernel report how many datagrams it dropped on a full queue */
+    int on = 1;
+    setsockopt(mySocket->socketDescriptor(), SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on));
+#endif
+}
+
 void QWClientPrivate::setSpectator(bool spectate)
 {
     if(myState == QWClient::ConnectedState)
@@ -215,10 +272,14 @@ void QWClientPrivate::sendCmd(const QString &cmd)
 
 QWClientPrivate::~QWClientPrivate()
 {
+    if(myPool)
+        myPool->remove(myClient);
+
     delete myTime;
     delete myLastServerReplyTime;
     delete mySocket;
     delete myDownload;
+    delete myCaptureFile;
 }
 
 static QRegExp packRegex("pak[0-9]+\\.pak", Qt::CaseInsensitive);
@@ -257,6 +318,59 @@ void QWClientPrivate::run()
     sendToServer();
 }
 
+void QWClientPrivate::runUntil(int msecs)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    run();
+    while(myState != QWClient::DisconnectedState)
+    {
+        qint64 left = msecs - timer.elapsed();
+        if(left <= 0)
+            return;
+
+        int wait = nextDeadline();
+        if(wait < 0 || wait > left)
+            wait = left;
+
+        /* Sleeps until a datagram arrives or the deadline passes */
+        if(wait > 0)
+            mySocket->waitForReadyRead(wait);
+        run();
+    }
+}
+
+int QWClientPrivate::nextDeadline() const
+{
+    int send = msecsToNextSend();
+    if(send < 0)
+        return -1;
+
+    int timeout = qMax(0, 30000 - myLastServerReplyTime->msecsTo(QTime::currentTime()));
+    return qMin(send, timeout);
+}
+
+int QWClientPrivate::msecsToNextSend() const
+{
+    if(myState == QWClient::DisconnectedState)
+        return -1;
+
+    int interval;
+    if(myState == QWClient::ConnectingState)
+        interval = 5000;
+    else
+        interval = (myState != QWClient::ConnectedState || myDownload->isOpen()) ? 12 : myPing;
+
+    return qMax(0, interval - myTime->elapsed());
+}
+
+void QWClientPrivate::socketChanged()
+{
+    if(myPool)
+        myPool->socketChanged(this);
+}
+
 void QWClientPrivate::sendToServer(bool dontWait)
 {
     /* Check for resend */
@@ -317,8 +431,7 @@ void QWClientPrivate::sendToServer(bool dontWait)
     }
 
     /* Finally send the packet */
-    mySocket->write(myOutData);
-    mySocket->waitForBytesWritten();
+    sendDatagram(myOutData.constData(), myOutData.size());
     myOutData.clear();
     myOutStream.device()->seek(0);
 
@@ -327,35 +440,188 @@ void QWClientPrivate::sendToServer(bool dontWait)
 
 void QWClientPrivate::readPackets()
 {
+    myPacketsDrained = 0;
+    myPacketsDropped = 0;
+
     if(!mySocket->isOpen())
         return;
 
-    if(!mySocket->hasPendingDatagrams())
+#ifdef Q_OS_LINUX
+    readPacketsBatched();
+#else
+    while(mySocket->isOpen() && mySocket->hasPendingDatagrams())
+    {
+        qint64 size = mySocket->pendingDatagramSize();
+        if(size > MAX_UDP_PACKET)
+        {
+            mySocket->readDatagram(myRecvRing.data(), 0);
+            myPacketsDropped++;
+            continue;
+        }
+        size = mySocket->readDatagram(myRecvRing.data(), size);
+        if(size < 0)
+            break;
+        myPacketsDrained++;
+        processDatagram(myRecvRing.data(), size);
+    }
+#endif
+
+    if(!myPacketsDrained)
     {
-        if(myLastServerReplyTime->secsTo(QTime::currentTime()) >= 30)
+        if(mySocket->isOpen() && myLastServerReplyTime->secsTo(QTime::currentTime()) >= 30)
         {
             myClient->onError("Client Timed Out.");
             disconnect();
-            return;
         }
         return;
     }
 
     *myLastServerReplyTime = QTime::currentTime();
+}
+
+void QWClientPrivate::replay(const char *data, int size)
+{
+    if(size < 0 || size > MAX_UDP_PACKET)
+        return;
+
+    memcpy(myRecvRing.data(), data, size);
+    myReplayFlag = true;
+    processDatagram(myRecvRing.data(), size);
+    myReplayFlag = false;
+}
+
+bool QWClientPrivate::setCaptureFile(const QString &fileName)
+{
+    delete myCaptureFile;
+    myCaptureFile = NULL;
+
+    if(fileName.isEmpty())
+        return true;
+
+    myCaptureFile = new QFile(fileName);
+    if(!myCaptureFile->open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        delete myCaptureFile;
+        myCaptureFile = NULL;
+        return false;
+    }
+    return true;
+}
+
+#ifdef Q_OS_LINUX
+void QWClientPrivate::readPacketsBatched()
+{
+    struct mmsghdr	msgs[RecvBatchSize];
+    struct iovec		iovs[RecvBatchSize];
+    char						control[RecvBatchSize][CMSG_SPACE(sizeof(quint32))];
+    int							fd = mySocket->socketDescriptor();
+
+    for(;;)
+    {
+        memset(msgs, 0, sizeof(msgs));
+        for(int i = 0; i < RecvBatchSize; ++i)
+        {
+            iovs[i].iov_base = myRecvRing.data() + i * RecvSlotSize;
+            iovs[i].iov_len = MAX_UDP_PACKET;
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_control = control[i];
+            msgs[i].msg_hdr.msg_controllen = sizeof(control[i]);
+        }
+
+        int count = recvmmsg(fd, msgs, RecvBatchSize, MSG_DONTWAIT, NULL);
+        if(count <= 0)
+            return;
+
+        /* Parse in arrival order, the whole batch is already out of the kernel */
+        for(int i = 0; i < count; ++i)
+        {
+            struct msghdr* hdr = &msgs[i].msg_hdr;
+            for(struct cmsghdr* cmsg = CMSG_FIRSTHDR(hdr); cmsg; cmsg = CMSG_NXTHDR(hdr, cmsg))
+            {
+                if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL)
+                {
+                    quint32 drops;
+                    memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+                    myPacketsDropped += drops - myKernelDropCount;
+                    myKernelDropCount = drops;
+                }
+            }
+
+            if(hdr->msg_flags & MSG_TRUNC)
+            {
+                myPacketsDropped++;
+                continue;
+            }
+
+            myPacketsDrained++;
+            processDatagram(myRecvRing.data() + i * RecvSlotSize, msgs[i].msg_len);
+
+            /* We may have been disconnected by the server */
+            if(!mySocket->isOpen())
+                return;
+        }
+
+        if(count < RecvBatchSize)
+            return;
+    }
+}
+#endif
+
+void QWClientPrivate::processDatagram(char *data, int size)
+{
+    if(myCaptureFile)
+    {
+        quint32 length = qToLittleEndian<quint32>(size);
+        myCaptureFile->write(reinterpret_cast<const char*>(&length), sizeof(length));
+        myCaptureFile->write(data, size);
+    }
 
-    myInData.resize(mySocket->pendingDatagramSize());
-    //	myInData = mySocket->readAll();
-    mySocket->readDatagram(myInData.data(), mySocket->pendingDatagramSize());
+    /* Strings handed out by readStringView() can't run past the datagram */
+    data[size] = '\0';
 
-    myInStream.device()->seek(0);
+    myInBegin = myInCursor = reinterpret_cast<quint8*>(data);
+    myInEnd = myInBegin + size;
+    myBadReadFlag = false;
 
-    quint32 seq;
-    myInStream >> seq;
+    quint32 seq = readLong();
 
     if(seq == 0xffffffff)
+    {
         parseConnectionless();
-    else
-        parseServerMessage();
+        return;
+    }
+
+    /* Nothing of a stale datagram is parsed, what the last accepted one left stays readable */
+    if(!acceptMessage())
+        return;
+
+    /* Per message buffers, they stay readable until the next message */
+    myProjectileCount = 0;
+    myTempEntityCount = 0;
+    mySeenPlayers = 0;
+    myPlayerFrameFlag = false;
+
+    parseServerMessage();
+    if(myPlayerFrameFlag)
+        removeUnseenPlayers();
+    if(myEvents.size())
+    {
+        if(myEventQueue)
+        {
+            for(int i = 0; i < myEvents.size(); ++i)
+                myEventQueue->push(myEvents.at(i));
+        }
+        else
+        {
+            myClient->onEvents(myEvents.constData(), myEvents.size());
+        }
+        myEvents.resize(0);
+    }
+    if(myTempEntityCount)
+        myClient->onTempEntities(myTempEntities, myTempEntityCount);
+    if(myPublishSnapshotsFlag && myState == QWClient::ConnectedState)
+        publishSnapshot();
 }
 
 void QWClientPrivate::parseConnectionless()
@@ -379,7 +645,6 @@ void QWClientPrivate::parseConnectionless()
         connString.append("\\msg\\1\\noaim\\1\\topcolor\\" + QString::number(myTopColor) + "\\bottomcolor\\" + QString::number(myBottomColor) + "\\w_switch\\2\\b_switch\\2\\*client\\" + myClientName);
         connString.append(" " + myClientVersion + "\\name\\" + myName + "\\team\\" + myTeam + "\\spectator\\" + (mySpectatorFlag ? "1" : "0") + "\\pmodel\\33168\\emodel\\6967\\*z_ext\\383\"");
         connString.append(QString::asprintf("\n0x%x 0x%x\n", PROTOCOL_VERSION_FTE, FTE_PEXT_FLOATCOORDS));
-        myInStream.device()->seek(0);
         sendConnectionless(connString.toLatin1());
         myClient->onConnection();
     }
@@ -395,11 +660,11 @@ void QWClientPrivate::parseConnectionless()
         break;
 
     case A2C_PRINT:
-        myClient->onOOBPrint(readString().toLatin1().data());
+        myClient->onOOBPrint(readStringView().data());
         break;
 
     case A2C_CLIENT_COMMAND:
-        myClient->onOOBCommand(readString().toLatin1().data());
+        myClient->onOOBCommand(readStringView().data());
         break;
 
     case A2A_PING:
@@ -415,7 +680,7 @@ void QWClientPrivate::parseConnectionless()
         break;
 
     case A2A_ECHO:
-        myClient->onOOBEcho(readString().toLatin1().data());
+        myClient->onOOBEcho(readStringView().data());
         break;
     }
 }
@@ -464,6 +729,7 @@ bool QWClientPrivate::readFile(const QString &filename, char **data, quint64 *le
 }
 
 //int	bitCounts[32];	/// just for protocol profiling
+template<bool FloatCoords>
 void QWClientPrivate::parseDelta(entityState_t *from, entityState_t *to, int bits)
 {
     int			i;
@@ -511,22 +777,22 @@ void QWClientPrivate::parseDelta(entityState_t *from, entityState_t *to, int bit
         to->effects = readByte();
 
     if(bits & U_ORIGIN1)
-        to->origin[0] = readCoord();
+        to->origin[0] = readCoord<FloatCoords>();
 
     if(bits & U_ANGLE1)
-        to->angles[0] = readAngle();
+        to->angles[0] = readAngle<FloatCoords>();
 
     if(bits & U_ORIGIN2)
-        to->origin[1] = readCoord();
+        to->origin[1] = readCoord<FloatCoords>();
 
     if(bits & U_ANGLE2)
-        to->angles[1] = readAngle();
+        to->angles[1] = readAngle<FloatCoords>();
 
     if(bits & U_ORIGIN3)
-        to->origin[2] = readCoord();
+        to->origin[2] = readCoord<FloatCoords>();
 
     if(bits & U_ANGLE3)
-        to->angles[2] = readAngle();
+        to->angles[2] = readAngle<FloatCoords>();
 
     if(bits & U_SOLID)
     {}
@@ -534,11 +800,39 @@ void QWClientPrivate::parseDelta(entityState_t *from, entityState_t *to, int bit
     if(morebits & U_FTE_TRANS && myFTEProtocolExtensions & FTE_PEXT_TRANS)
         readByte();
     if(morebits & U_FTE_ENTITYDBL)
-    {}
+        to->number += 512;
     if(morebits & U_FTE_ENTITYDBL2)
-    {}
-    if(morebits & U_FTE_MODELDBL)
-    {}
+        to->number += 1024;
+    if(morebits & U_FTE_MODELDBL && bits & U_MODEL)
+        to->modelindex += 256;
+}
+
+/* Full entity number of the delta about to be parsed, the FTE high bits come after the word */
+int QWClientPrivate::peekEntityNumber(int bits) const
+{
+    const quint8* cursor = myInCursor;
+    int number = bits & 511;
+
+    if(bits & U_MOREBITS && cursor < myInEnd)
+        bits |= *cursor++;
+
+    if(bits & U_FTE_EVENMORE && myFTEProtocolExtensions && cursor < myInEnd)
+    {
+        if(*cursor & U_FTE_ENTITYDBL)
+            number += 512;
+        if(*cursor & U_FTE_ENTITYDBL2)
+            number += 1024;
+    }
+
+    return number;
+}
+
+void QWClientPrivate::parseDelta(entityState_t *from, entityState_t *to, int bits)
+{
+    if(myFTEProtocolExtensions & FTE_PEXT_FLOATCOORDS)
+        parseDelta<true>(from, to, bits);
+    else
+        parseDelta<false>(from, to, bits);
 }
 
 //========================================================================
@@ -568,32 +862,21 @@ float QWClientPrivate::littleFloat(float f)
         return f;
 }
 
-bool QWClientPrivate::checkForBadRead(quint8 typeSize)
+template<bool FloatCoords>
+float QWClientPrivate::readAngle()
 {
-    if(myInStream.device()->pos()+typeSize > myInStream.device()->size())
-    {
-        myBadReadFlag = true;
-        return true;
-    }
-    return false;
+    if(FloatCoords)
+        return readAngle16();
+
+    if(checkForBadRead(1))
+        return -1;
+
+    return *myInCursor++ * (360.0f/256);
 }
 
 float QWClientPrivate::readAngle()
 {
-    if (!(this->myFTEProtocolExtensions & FTE_PEXT_FLOATCOORDS))
-    {
-        if(checkForBadRead(1))
-            return -1;
-
-        quint8 angle;
-
-        myInStream >> angle;
-        return angle * (360.0f/256);
-    }
-    else
-    {
-        return readAngle16();
-    }
+    return myFTEProtocolExtensions & FTE_PEXT_FLOATCOORDS ? readAngle<true>() : readAngle<false>();
 }
 
 float QWClientPrivate::readAngle16()
@@ -601,58 +884,26 @@ float QWClientPrivate::readAngle16()
     if(checkForBadRead(2))
         return -1;
 
-    quint16 angle;
-
-    myInStream >> angle;
+    quint16 angle = qFromLittleEndian<quint16>(myInCursor);
+    myInCursor += 2;
     return angle * (360.0f/65536);
 }
 
+template<bool FloatCoords>
 float QWClientPrivate::readCoord()
 {
-    if (! (this->myFTEProtocolExtensions & FTE_PEXT_FLOATCOORDS))
-    {
-        if(checkForBadRead(2))
-            return -1;
-
-        quint16 coord;
-
-        myInStream >> coord;
-        return coord * (1.0f/8);
-    }
-    else
-    {
-        if(checkForBadRead(4))
-            return -1;
+    if(FloatCoords)
         return readFloat();
-    }
-}
-
-quint8 QWClientPrivate::readByte()
-{
-    if(checkForBadRead(1))
-        return 0xff;
 
-    quint8 byte;
+    if(checkForBadRead(2))
+        return -1;
 
-    myInStream >> byte;
-    return byte;
+    return readShort() * (1.0f/8);
 }
 
-float QWClientPrivate::readFloat()
+float QWClientPrivate::readCoord()
 {
-    union
-    {
-        quint8	b[4];
-        int			l;
-        float		f;
-    } d;
-
-    d.b[0] = readByte();
-    d.b[1] = readByte();
-    d.b[2] = readByte();
-    d.b[3] = readByte();
-
-    return littleFloat(d.f);
+    return myFTEProtocolExtensions & FTE_PEXT_FLOATCOORDS ? readCoord<true>() : readCoord<false>();
 }
 
 const QString QWClientPrivate::readString()
@@ -668,26 +919,22 @@ const QString QWClientPrivate::readString()
     return str;
 }
 
-qint32 QWClientPrivate::readLong()
-{
-    if(checkForBadRead(4))
-        return -1;
-
-    quint32 l;
-
-    myInStream >> l;
-    return l;
-}
-
-qint16 QWClientPrivate::readShort()
+QLatin1String QWClientPrivate::readStringView()
 {
-    if(checkForBadRead(2))
-        return -1;
+    /* Like readString() a 0xff byte also ends the string, the sentinel at myInEnd stops the scan */
+    char* str = reinterpret_cast<char*>(myInCursor);
+    size_t len = strcspn(str, "\xff");
 
-    qint16 s;
+    myInCursor += len;
+    if(myInCursor == myInEnd)
+    {
+        myBadReadFlag = true;
+        return QLatin1String(str, len);
+    }
 
-    myInStream >> s;
-    return s;
+    /* Terminate in place so callbacks can take it as a C string */
+    *myInCursor++ = '\0';
+    return QLatin1String(str, len);
 }
 
 //========================================================================
@@ -701,6 +948,7 @@ void QWClientPrivate::parseSvcDisconnect()
 {
     mySocket->close();
     myState = QWClient::DisconnectedState;
+    socketChanged();
     myClient->onDisconnect();
 
     if (myWrongChecksumFlag) {
@@ -713,63 +961,97 @@ void QWClientPrivate::parseSvcDisconnect()
 static QRegExp mapChecksumRegex("^Map model file does not match \\(maps\\/\\w+\\.bsp\\), -?\\d+ != (-?\\d+)\\/(-?\\d+)\\.");
 void QWClientPrivate::parseSvcPrint()
 {
-    quint8	level = readByte();
-    QString msg		= readString();
+    quint8				level = readByte();
+    QLatin1String	msg		= readStringView();
 
-    if (mapChecksumRegex.indexIn(msg) != -1) {
+    if (msg.startsWith(QLatin1String("Map model file does not match")) && mapChecksumRegex.indexIn(QString(msg)) != -1) {
         _mapChecksum = mapChecksumRegex.capturedTexts().at(1).toInt();
         myWrongChecksumFlag = true;
         return;
     }
-    myClient->onPrint(level, msg.toLatin1().data());
+    if(myBatchEventsFlag)
+    {
+        QWClient::Event* e = appendEvent(QWClient::PrintEvent);
+        e->value = level;
+        e->text = msg.data();
+        return;
+    }
+    myClient->onPrint(level, msg.data());
 }
 
 void QWClientPrivate::parseSvcCenterPrint()
 {
-    myClient->onCenterPrint(readString().toLatin1().data());
+    const char* msg = readStringView().data();
+
+    if(myBatchEventsFlag)
+        appendEvent(QWClient::CenterPrintEvent)->text = msg;
+    else
+        myClient->onCenterPrint(msg);
 }
 
 void QWClientPrivate::parseSvcStuffText()
 {
-    QStringList commands = readString().split("\n");
-    
-    for(int i = 0; i < commands.size(); ++i)
+    QLatin1String text = readStringView();
+    char*	cmdStart = const_cast<char*>(text.data());
+    char*	textEnd = cmdStart + text.size();
+
+    for(;;)
     {
-        QString cmd = commands.at(i);
+        /* Split into lines in place */
+        char* cmdEnd = static_cast<char*>(memchr(cmdStart, '\n', textEnd - cmdStart));
+        if(cmdEnd)
+            *cmdEnd = '\0';
+        else
+            cmdEnd = textEnd;
 
-        if(cmd == "reconnect" || cmd == "cmd new")
+        QLatin1String cmd(cmdStart, cmdEnd - cmdStart);
+
+        if(cmd == QLatin1String("reconnect") || cmd == QLatin1String("cmd new"))
         {
             writeByte(&myReliableOutStream, clc_stringcmd);
             writeString(&myReliableOutStream, "new");
         }
-        else if(cmd == "cmd pext")
+        else if(cmd == QLatin1String("cmd pext"))
         {
             writeByte(&myReliableOutStream, clc_stringcmd);
             writeString(&myReliableOutStream, "pext 0x00000000 0x00000000 0x00000000");
         }
-        else if(cmd.startsWith("cmd spawn"))
+        else if(cmd.startsWith(QLatin1String("cmd spawn")))
         {
             writeByte(&myReliableOutStream, clc_stringcmd);
-            writeString(&myReliableOutStream, cmd.section(' ', 1));
+            writeString(&myReliableOutStream, QString(cmd).section(' ', 1));
         }
-        else if(cmd.startsWith("cmd prespawn"))
+        else if(cmd.startsWith(QLatin1String("cmd prespawn")))
         {
             writeByte(&myReliableOutStream, clc_stringcmd);
-            writeString(&myReliableOutStream, cmd.section(' ', 1));
+            writeString(&myReliableOutStream, QString(cmd).section(' ', 1));
         }
-        else if(cmd == "skins")
+        else if(cmd == QLatin1String("skins"))
         {
             writeByte(&myReliableOutStream, clc_stringcmd);
             writeString(&myReliableOutStream, QString("begin " + QString::number(myServerCount)));
         }
-        else if(cmd.startsWith("packet"))
+        else if(cmd.startsWith(QLatin1String("fullserverinfo ")))
+        {
+            /* fullserverinfo "\key\value..." */
+            QByteArray info = QString(cmd).section('"', 1, 1).toLatin1();
+            myServerInfo.setInfoString(info.constData());
+        }
+        else if(cmd.startsWith(QLatin1String("packet")))
         {
             QRegExp regex("\"(.+)\"");
-            int pos = regex.indexIn(cmd);
+            int pos = regex.indexIn(QString(cmd));
             if(pos != -1)
                 sendConnectionless(regex.capturedTexts().at(1).toLatin1());
         }
-        myClient->onStuffedCmd(cmd.toLatin1().data());
+        if(myBatchEventsFlag)
+            appendEvent(QWClient::StuffedCmdEvent)->text = cmdStart;
+        else
+            myClient->onStuffedCmd(cmdStart);
+
+        if(cmdEnd == textEnd)
+            break;
+        cmdStart = cmdEnd + 1;
     }
 }
 
@@ -777,10 +1059,21 @@ void QWClientPrivate::parseSvcDamage()
 {
     int armor = readByte();
     int blood = readByte();
-    myClient->onDamage(armor, blood);
-    readCoord();
-    readCoord();
-    readCoord();
+    float from[3];
+
+    if(!myBatchEventsFlag)
+        myClient->onDamage(armor, blood);
+    for(int i = 0; i < 3; i++)
+        from[i] = readCoord();
+
+    if(myBatchEventsFlag)
+    {
+        QWClient::Event* e = appendEvent(QWClient::DamageEvent);
+        e->value = armor;
+        e->value2 = blood;
+        for(int i = 0; i < 3; i++)
+            e->vector[i] = from[i];
+    }
 }
 
 void QWClientPrivate::parseSvcServerData()
@@ -801,6 +1094,17 @@ void QWClientPrivate::parseSvcServerData()
             break;
     }
 
+    /* Extensions hold until the next serverdata, pick the matching parsers once */
+    selectSvcParsers();
+
+    /* Entity frames and baselines from the previous level can't be delta'd from */
+    resetEntityFrames();
+    resetBaselines();
+    resetPlayers();
+    resetScoreboard();
+    resetStats();
+    myPositionHistory.clear();
+
     myServerCount = readLong();
 
     myGameDir = readString();
@@ -817,7 +1121,7 @@ void QWClientPrivate::parseSvcServerData()
     else
         mySpectatorFlag = false;
 
-    QString lvlName = readString();
+    QLatin1String lvlName = readStringView();
     float a = readFloat();
     float b = readFloat();
     float c = readFloat();
@@ -830,7 +1134,7 @@ void QWClientPrivate::parseSvcServerData()
     float j = readFloat();
     myClient->onLevelChanged(
                 playerNum,
-                lvlName.toLatin1().data(),
+                lvlName.data(),
                 a,b,c,d,e,f,g,h,i,j
                 );
     writeByte(&myReliableOutStream, clc_stringcmd);
@@ -850,9 +1154,10 @@ void QWClientPrivate::parseSvcSetAngle()
 void QWClientPrivate::parseSvcLightStyle()
 {
     readByte();
-    readString();
+    readStringView();
 }
 
+template<bool FloatCoords>
 void QWClientPrivate::parseSvcSound()
 {
     quint16 channel;
@@ -862,10 +1167,21 @@ void QWClientPrivate::parseSvcSound()
         readByte();
     if (channel & SND_ATTENUATION)
         readByte();
-    myClient->onPlaySound(readByte());
-    readCoord();
-    readCoord();
-    readCoord();
+    int sound = readByte();
+    float origin[3];
+
+    if(!myBatchEventsFlag)
+        myClient->onPlaySound(sound);
+    for(int i = 0; i < 3; i++)
+        origin[i] = readCoord<FloatCoords>();
+
+    if(myBatchEventsFlag)
+    {
+        QWClient::Event* e = appendEvent(QWClient::SoundEvent);
+        e->value = sound;
+        for(int i = 0; i < 3; i++)
+            e->vector[i] = origin[i];
+    }
 }
 
 void QWClientPrivate::parseSvcStopSound()
@@ -877,126 +1193,198 @@ void QWClientPrivate::parseSvcUpdateFrags()
 {
     //printf("svc_updatefrags\n");
     quint8 playerNum = readByte();
-    quint16 frags = readShort();
-    myClient->onUpdateFrags(playerNum, frags);
+    qint16 frags = readShort();
+    if(playerNum < MAX_CLIENTS && myScoreboard[playerNum].frags != frags)
+    {
+        myScoreboard[playerNum].frags = frags;
+        myScoreboardChanges |= 1u << playerNum;
+    }
+    if(myBatchEventsFlag)
+        appendEvent(QWClient::FragsEvent, playerNum)->value = frags;
+    else
+        myClient->onUpdateFrags(playerNum, frags);
 }
 
 void QWClientPrivate::parseSvcUpdatePing()
 {
     quint8 playerNum = readByte();
     quint16 ping = readShort();
-    myClient->onUpdatePing(playerNum, ping);
+    if(playerNum < MAX_CLIENTS && myScoreboard[playerNum].ping != ping)
+    {
+        myScoreboard[playerNum].ping = ping;
+        myScoreboardChanges |= 1u << playerNum;
+    }
+    if(myBatchEventsFlag)
+        appendEvent(QWClient::PingEvent, playerNum)->value = ping;
+    else
+        myClient->onUpdatePing(playerNum, ping);
 }
 
 void QWClientPrivate::parseSvcUpdatePL()
 {
     quint8 playerNum = readByte();
     quint8 pl = readByte();
-    myClient->onUpdatePL(playerNum, pl);
+    if(playerNum < MAX_CLIENTS && myScoreboard[playerNum].pl != pl)
+    {
+        myScoreboard[playerNum].pl = pl;
+        myScoreboardChanges |= 1u << playerNum;
+    }
+    if(myBatchEventsFlag)
+        appendEvent(QWClient::PacketLossEvent, playerNum)->value = pl;
+    else
+        myClient->onUpdatePL(playerNum, pl);
 }
 
 void QWClientPrivate::parseSvcUpdateEnterTime()
 {
-    readByte();
-    readFloat();
+    quint8 playerNum = readByte();
+    float secondsAgo = readFloat();
+    if(playerNum < MAX_CLIENTS)
+    {
+        /* Rebuilt from a float and our receive time, resends of the same entry come out a little off */
+        qint64 enterTime = myClock.elapsed() - (qint64)(secondsAgo * 1000);
+        if(qAbs(enterTime - myScoreboard[playerNum].enterTime) > 1000)
+        {
+            myScoreboard[playerNum].enterTime = enterTime;
+            myScoreboardChanges |= 1u << playerNum;
+        }
+    }
 }
 
-void QWClientPrivate::parseSvcSpawnBaseLine()
+void QWClientPrivate::readBaseline(entityState_t *es)
 {
-    //printf("svc_spawnbaseline\n");
-    readShort();
-    readByte();
-    readByte();
-    readByte();
-    readByte();
+    memset(es, 0, sizeof(entityState_t));
+    es->modelindex = readByte();
+    es->frame = readByte();
+    es->colormap = readByte();
+    es->skinnum = readByte();
     for(int i = 0; i < 3; i++)
     {
-        readCoord();
-        readAngle();
+        es->origin[i] = readCoord();
+        es->angles[i] = readAngle();
     }
 }
 
+void QWClientPrivate::parseSvcSpawnBaseLine()
+{
+    entityState_t es;
+    quint16 number = readShort();
+
+    readBaseline(&es);
+    es.number = number;
+    if(number < MAX_EDICTS && !myBadReadFlag)
+        myBaselines[number] = es;
+}
+
 void QWClientPrivate::parseSvcSpawnStatic()
 {
-    //printf("svc_spawnstatic\n");
-    //rawReadShort();
-    readByte();
-    readByte();
-    readByte();
-    readByte();
-    for(int i = 0; i < 3; i++)
-    {
-        readCoord();
-        readAngle();
-    }
+    entityState_t es;
+
+    readBaseline(&es);
+    if(!myBadReadFlag)
+        myStaticEntities.append(es);
 }
 
+template<bool FloatCoords>
 void QWClientPrivate::parseSvcTempEntity()
 {
     //printf("svc_temp_entity\n");
-    quint8 c = readByte();
-    bool	 parsed = false;
+    QWClient::TempEntity scratch;
+    QWClient::TempEntity& te = myTempEntityCount < MaxTempEntities ? myTempEntities[myTempEntityCount] : scratch;
 
-    switch(c)
+    te.type = readByte();
+    te.count = 1;
+    te.entity = 0;
+
+    switch(te.type)
     {
     case TE_LIGHTNING1:
     case TE_LIGHTNING2:
     case TE_LIGHTNING3:
-        readShort();
-
-        readCoord();
-        readCoord();
-        readCoord();
-
-        readCoord();
-        readCoord();
-        readCoord();
-        parsed = true;
+        te.entity = readShort();
+        for(int i = 0; i < 3; i++)
+            te.origin[i] = readCoord<FloatCoords>();
+        for(int i = 0; i < 3; i++)
+            te.end[i] = readCoord<FloatCoords>();
         break;
 
     case TE_GUNSHOT:
-        readByte();
-        readCoord();
-        readCoord();
-        readCoord();
-        parsed = true;
-        break;
-
     case TE_BLOOD:
-        readByte();
-        readCoord();
-        readCoord();
-        readCoord();
-        parsed = true;
+        te.count = readByte();
+        for(int i = 0; i < 3; i++)
+            te.origin[i] = te.end[i] = readCoord<FloatCoords>();
         break;
 
-    case TE_LIGHTNINGBLOOD:
-        readCoord();
-        readCoord();
-        readCoord();
-        parsed = true;
+    default:
+        for(int i = 0; i < 3; i++)
+            te.origin[i] = te.end[i] = readCoord<FloatCoords>();
         break;
     }
 
-    if(!parsed)
-    {
-        readCoord();
-        readCoord();
-        readCoord();
-    }
+    if(!myBadReadFlag && &te != &scratch)
+        myTempEntityCount++;
+}
+
+int QWClientPrivate::tempEntityCount() const
+{
+    return myTempEntityCount;
+}
+
+QWClient::Event* QWClientPrivate::appendEvent(QWClient::EventType type, int playerNum)
+{
+    myEvents.resize(myEvents.size() + 1);
+
+    QWClient::Event* e = &myEvents.last();
+    memset(e, 0, sizeof(*e));
+    e->type = type;
+    e->playerNum = playerNum;
+    return e;
+}
+
+void QWClientPrivate::setEventBatching(bool enabled)
+{
+    myBatchEventsFlag = enabled;
+}
+
+bool QWClientPrivate::eventBatching() const
+{
+    return myBatchEventsFlag;
+}
+
+void QWClientPrivate::setEventQueue(QWEventQueue *queue)
+{
+    myEventQueue = queue;
+    if(queue)
+        myBatchEventsFlag = true;
+}
+
+const QWClient::TempEntity* QWClientPrivate::tempEntities() const
+{
+    return myTempEntities;
 }
 
 void QWClientPrivate::parseSvcUpdateStat()
 {
-    readByte();
-    readByte();
+    quint8 index = readByte();
+    quint8 value = readByte();
+    setStat(index, value);
 }
 
 void QWClientPrivate::parseSvcUpdateStatLong()
 {
     //printf("svc_updatestatlong\n");
-    readByte();
-    readLong();
+    quint8 index = readByte();
+    qint32 value = readLong();
+    setStat(index, value);
+}
+
+void QWClientPrivate::setStat(int index, int value)
+{
+    if(index < MAX_CL_STATS && myStats[index] != value)
+    {
+        myStats[index] = value;
+        myStatChanges |= 1u << index;
+    }
 }
 
 void QWClientPrivate::parseSvcSpawnStaticSound()
@@ -1029,7 +1417,7 @@ void QWClientPrivate::parseSvcIntermission()
 void QWClientPrivate::parseSvcFinale()
 {
     //printf("svc_finale\n");
-    readString();
+    readStringView();
 }
 
 void QWClientPrivate::parseSvcSellScreen()
@@ -1057,36 +1445,80 @@ void QWClientPrivate::parseSvcUpdateUserinfo()
 {
     quint8 playerNum = readByte();
     quint32 userID = readLong();
-    QString info = readString();
-    myClient->onUpdateUserInfo(playerNum, userID, info.toLatin1().data());
+    QLatin1String info = readStringView();
+
+    if(playerNum < MAX_CLIENTS)
+    {
+        QWClient::ScoreboardEntry& entry = myScoreboard[playerNum];
+        bool active = !info.isEmpty();
+
+        /* An empty userinfo is a player leaving */
+        if(!active && myIndexedPlayers & (1u << playerNum))
+        {
+            mySpatialIndex.removePlayer(playerNum);
+            myIndexedPlayers &= ~(1u << playerNum);
+        }
+        if(myUserInfo[playerNum].setInfoString(info.data()) || entry.userID != (int)userID || entry.active != active)
+        {
+            entry.userID = userID;
+            entry.active = active;
+            updateScoreboardInfo(playerNum);
+            myScoreboardChanges |= 1u << playerNum;
+        }
+    }
+    if(myBatchEventsFlag)
+    {
+        QWClient::Event* e = appendEvent(QWClient::UserInfoEvent, playerNum);
+        e->value = userID;
+        e->text = info.data();
+        return;
+    }
+    myClient->onUpdateUserInfo(playerNum, userID, info.data());
 }
 
 void QWClientPrivate::parseSvcSetinfo()
 {
     //printf("svc_setinfo\n");
-    QString key, value;
-    int playerNum = readByte();
-    key = readString();
-    value = readString();
+    int						playerNum = readByte();
+    QLatin1String	key = readStringView();
+    QLatin1String	value = readStringView();
 
     //that must be done
-    if(key == "rate")
+    if(key == QLatin1String("rate"))
     {
-        myRate = value.toUInt();
-        sendCmd("setinfo \"rate\" \"" + value + "\"");
+        myRate = QString(value).toUInt();
+        sendCmd("setinfo \"rate\" \"" + QString(value) + "\"");
     }
 
-    myClient->onSetInfo(playerNum, key.toLatin1().data(), value.toLatin1().data());
+    if(playerNum < MAX_CLIENTS && myUserInfo[playerNum].set(key.data(), value.data()))
+    {
+        updateScoreboardInfo(playerNum);
+        myScoreboardChanges |= 1u << playerNum;
+    }
+    if(myBatchEventsFlag)
+    {
+        QWClient::Event* e = appendEvent(QWClient::SetInfoEvent, playerNum);
+        e->text = key.data();
+        e->text2 = value.data();
+        return;
+    }
+    myClient->onSetInfo(playerNum, key.data(), value.data());
 }
 
 void QWClientPrivate::parseSvcServerinfo()
 {
     //printf("svc_serverinfo\n");
-    QString key, value;
-
-    key = readString();
-    value = readString();
-    myClient->onServerInfo(key.toLatin1().data(), value.toLatin1().data());
+    QLatin1String key = readStringView();
+    QLatin1String value = readStringView();
+    myServerInfo.set(key.data(), value.data());
+    if(myBatchEventsFlag)
+    {
+        QWClient::Event* e = appendEvent(QWClient::ServerInfoEvent);
+        e->text = key.data();
+        e->text2 = value.data();
+        return;
+    }
+    myClient->onServerInfo(key.data(), value.data());
 }
 
 void QWClientPrivate::startDownload(const QString &fileName)
@@ -1239,17 +1671,21 @@ void QWClientPrivate::parseSvcDownload()
         return;
     }
 
+    if(size < 0 || checkForBadRead(size))
+    {
+        myBadReadFlag = true;
+        return;
+    }
+
     if(!myDownload->isOpen())
     {
-        myInStream.device()->seek(myInStream.device()->pos() + size);
+        skipBytes(size);
         return;
     }
 
-    char*	temp = new char[size];
-    myInStream.readRawData(temp, size);
-    myDownload->write(temp, size);
+    myDownload->write(reinterpret_cast<const char*>(myInCursor), size);
     myDownload->waitForBytesWritten(1000);
-    delete[] temp;
+    skipBytes(size);
 
     myClient->onDownloadProgress(percent);
     if(percent != 100)
@@ -1309,330 +1745,896 @@ void QWClientPrivate::readUserDeltaCmd(userCmd_t *from, userCmd_t *move)
 
 }
 
+template<bool FloatCoords>
 void QWClientPrivate::parseSvcPlayerinfo()
 {
     quint16		flags;
-    userCmd_t from, move;
+    userCmd_t nullcmd, cmd;
+    QWClient::PlayerState scratch;
 
-    memset(&from, 0, sizeof(userCmd_t));
-    memset(&move, 0, sizeof(userCmd_t));
+    memset(&nullcmd, 0, sizeof(userCmd_t));
     int playerNum = readByte();
+    QWClient::PlayerState& state = playerNum < MAX_CLIENTS ? myPlayers[playerNum] : scratch;
+
     flags = readShort();
-    float x = readCoord();
-    float y = readCoord();
-    float z = readCoord();
+    state.number = playerNum;
+    state.sequence = myIncomingSeq;
+    state.flags = flags;
+    for(int i = 0; i < 3; i++)
+        state.origin[i] = readCoord<FloatCoords>();
 
-    myClient->onPlayerInfo(playerNum, x, y, z);
+    if(!myBatchEventsFlag)
+        myClient->onPlayerInfo(playerNum, state.origin[0], state.origin[1], state.origin[2]);
 
-    readByte();
+    state.frame = readByte();
+    state.msec = flags & PF_MSEC ? readByte() : 0;
 
-    if(flags & PF_MSEC)
-        readByte();
+    /* The command is always delta'd from an empty one */
     if(flags & PF_COMMAND)
-        readUserDeltaCmd(&from, &move);
+        readUserDeltaCmd(&nullcmd, &cmd);
+    else
+        cmd = nullcmd;
+    for(int i = 0; i < 3; i++)
+        state.viewAngles[i] = cmd.angles[i];
+    state.forwardMove = cmd.forwardmove;
+    state.sideMove = cmd.sidemove;
+    state.upMove = cmd.upmove;
+    state.buttons = cmd.buttons;
+    state.impulse = cmd.impulse;
+    state.commandMsec = cmd.msec;
 
     for(int i = 0; i < 3; i++)
-    {
-        if(flags & (PF_VELOCITY1<<i))
-            readShort();
-    }
-    if(flags & PF_MODEL)
-        readByte();
-    if(flags & PF_SKINNUM)
-        readByte();
-    if(flags & PF_EFFECTS)
-        readByte();
-    if(flags & PF_WEAPONFRAME)
-        readByte();
+        state.velocity[i] = flags & (PF_VELOCITY1<<i) ? readShort() : 0;
+
+    state.modelIndex = flags & PF_MODEL ? readByte() : myPlayerModelIndex;
+    state.skinNum = flags & PF_SKINNUM ? readByte() : 0;
+    state.effects = flags & PF_EFFECTS ? readByte() : 0;
+    state.weaponFrame = flags & PF_WEAPONFRAME ? readByte() : 0;
     if(flags & PF_TRANS_Z && myFTEProtocolExtensions & FTE_PEXT_TRANS)
         readByte();
-}
 
-void QWClientPrivate::parseSvcNails()
-{
-    //printf("svc_nails\n");
-    quint8 c = readByte();
-    for(int i = 0; i < c; i++)
+    if(myBadReadFlag)
+        return;
+
+    state.active = true;
+    myPlayerFrameFlag = true;
+    if(playerNum < MAX_CLIENTS)
+    {
+        mySpatialIndex.setPlayer(playerNum, state.origin[0], state.origin[1], state.origin[2]);
+        myIndexedPlayers |= 1u << playerNum;
+        mySeenPlayers |= 1u << playerNum;
+
+        /* msec is how old the state already was when the server sent it */
+        if(myPositionHistory.depth())
+            myPositionHistory.record(playerNum, myClock.elapsed() - state.msec, state.origin);
+    }
+    /* The whole state stays in the player table for batched consumers */
+    if(myBatchEventsFlag)
     {
-        for(int j = 0; j < 6; j++)
-            readByte();
+        QWClient::Event* e = appendEvent(QWClient::PlayerInfoEvent, playerNum);
+        for(int i = 0; i < 3; i++)
+            e->vector[i] = state.origin[i];
+        return;
     }
+    myClient->onPlayerState(state);
 }
 
-void QWClientPrivate::parseSvcChokeCount()
+const QWClient::PlayerState& QWClientPrivate::playerState(int playerNum) const
 {
-    readByte();
+    static const QWClient::PlayerState none = QWClient::PlayerState();
+
+    if(playerNum < 0 || playerNum >= MAX_CLIENTS)
+        return none;
+    return myPlayers[playerNum];
 }
 
-void QWClientPrivate::parseSvcModellist()
+void QWClientPrivate::resetPlayers()
 {
-    quint8 i = readByte();
-    bool	 firstLoop = true;
-    for(;;)
+    memset(myPlayers, 0, sizeof(myPlayers));
+    for(int i = 0; i < MAX_CLIENTS; ++i)
     {
-        QString s = readString();
-        if(s.isEmpty())
-            break;
-        if(!i && firstLoop)
-        {
-            myMapName = s;
-            firstLoop = false;
-        }
-        myClient->onModelListFile(s.toLatin1().data());
-    }
-    i = readByte();
-    if(i)
-    {
-        writeByte(&myReliableOutStream, clc_stringcmd);
-        writeString(&myReliableOutStream, QString("modellist " + QString::number(myServerCount) + " " + QString::number(i)));
-        return;
-    }
-
-    if(!fileExists(myMapName) && !QWTables::getOriginalMapChecksum(myMapName))
-    {
-        preSpawn(_mapChecksum);
-        return;
+        myPlayers[i].number = i;
+        mySpatialIndex.removePlayer(i);
     }
-    preSpawn(mapChecksum(myMapName));
+    myPlayerModelIndex = 0;
+    myIndexedPlayers = 0;
+    mySeenPlayers = 0;
+    myPlayerFrameFlag = false;
 }
 
-void QWClientPrivate::parseSvcSoundlist()
+/* Players the server stopped sending are gone or out of sight, don't report stale positions */
+void QWClientPrivate::removeUnseenPlayers()
 {
-    quint8 i;
-
-    i = readByte();
-    for(;;)
-    {
-        QString s = readString();
-        if(s.isEmpty())
-            break;
-        myClient->onSoundListFile(s.toLatin1().data());
-    }
+    quint32 gone = myIndexedPlayers & ~mySeenPlayers;
 
-    i = readByte();
-    if(i)
+    for(int i = 0; gone; ++i, gone >>= 1)
     {
-        writeByte(&myReliableOutStream, clc_stringcmd);
-        writeString(&myReliableOutStream, QString("soundlist " + QString::number(myServerCount) + " " + QString::number(i)));
-        return;
+        if(gone & 1)
+            mySpatialIndex.removePlayer(i);
     }
-
-    //continue login
-    writeByte(&myReliableOutStream, clc_stringcmd);
-    writeString(&myReliableOutStream, QString("modellist " + QString::number(myServerCount) + " 0"));
+    myIndexedPlayers = mySeenPlayers;
 }
 
-void QWClientPrivate::parseSvcPacketEntities()
+void QWClientPrivate::resetScoreboard()
 {
-    int	word;
-    entityState_t	olde, newe;
-
-    memset(&olde, 0, sizeof(olde));
-
-    while (1)
-    {
-        word = (unsigned short)readShort();
+    memset(myScoreboard, 0, sizeof(myScoreboard));
+    for(int i = 0; i < MAX_CLIENTS; ++i)
+        myScoreboard[i].number = i;
+    for(int i = 0; i < MAX_CLIENTS; ++i)
+        myUserInfo[i].clear();
+    myScoreboardChanges = 0xffffffff;
+    myServerInfo.clear();
+}
 
-        if (!word)
-            break;	// done
+void QWClientPrivate::updateScoreboardInfo(int playerNum)
+{
+    QWClient::ScoreboardEntry& entry = myScoreboard[playerNum];
+    const QWInfo& info = myUserInfo[playerNum];
+    const char* spectator = info.value(QWInfo::Spectator);
 
-        parseDelta(&olde, &newe, word);
-    }
+    strncpy(entry.name, info.value(QWInfo::Name), sizeof(entry.name) - 1);
+    entry.name[sizeof(entry.name) - 1] = '\0';
+    strncpy(entry.team, info.value(QWInfo::Team), sizeof(entry.team) - 1);
+    entry.team[sizeof(entry.team) - 1] = '\0';
+    entry.spectator = *spectator && strcmp(spectator, "0");
+    entry.topColor = info.intValue(QWInfo::TopColor);
+    entry.bottomColor = info.intValue(QWInfo::BottomColor);
 }
 
-void QWClientPrivate::parseSvcDeltaPacketEntities()
+const QWClient::ScoreboardEntry& QWClientPrivate::scoreboard(int playerNum) const
 {
-    parseSvcPacketEntities();
+    static const QWClient::ScoreboardEntry none = QWClient::ScoreboardEntry();
+
+    if(playerNum < 0 || playerNum >= MAX_CLIENTS)
+        return none;
+    return myScoreboard[playerNum];
 }
 
-void QWClientPrivate::parseSvcMaxSpeed()
+quint32 QWClientPrivate::scoreboardChanges() const
 {
-    myClient->onMaxSpeedChange(readFloat());
+    return myScoreboardChanges;
 }
 
-void QWClientPrivate::parseSvcEntGravity()
+void QWClientPrivate::clearScoreboardChanges()
 {
-    myClient->onEntGravityChange(readFloat());
+    myScoreboardChanges = 0;
 }
 
-void QWClientPrivate::parseSvcSetPause()
+QString QWClientPrivate::serverInfo(const QString &key) const
 {
-    myClient->onSetPause(readByte());
+    return QString(myServerInfo.value(key.toLatin1().constData()));
 }
 
-void QWClientPrivate::parseSvcNails2()
+const QWInfo& QWClientPrivate::serverInfo() const
 {
-    quint8 c = readByte();
-    for(int i = 0; i < c; i++)
-    {
-        readByte();
-        for(int j = 0; j < 6; j++)
-            readByte();
-    }
+    return myServerInfo;
 }
 
-void QWClientPrivate::parseSvcFTEModellistShort()
+const QWInfo& QWClientPrivate::userInfo(int playerNum) const
 {
-    quint16 i = readShort();
-    bool	  firstLoop = true;
-    for(;;)
-    {
-        QString s;
-        s = readString();
-        if(s.isEmpty())
-            break;
-        if(!i && firstLoop)
-        {
-            myMapName = s;
-            firstLoop = false;
-        }
-        myClient->onModelListFile(s.toLatin1().data());
-    }
-    i = readByte();
-    if(i)
-    {
-        writeByte(&myReliableOutStream, clc_stringcmd);
-        writeString(&myReliableOutStream, QString("modellist " + QString::number(myServerCount) + " " + QString::number(i)));
-        return;
-    }
+    static const QWInfo none;
 
-    if(!fileExists(myMapName) && !QWTables::getOriginalMapChecksum(myMapName))
-    {
-        startDownload(myMapName);
-        return;
-    }
-    preSpawn(mapChecksum(myMapName));
+    if(playerNum < 0 || playerNum >= MAX_CLIENTS)
+        return none;
+    return myUserInfo[playerNum];
 }
 
-void QWClientPrivate::parseSvcFTESpawnBaseline2()
+void QWClientPrivate::resetStats()
 {
-    entityState_t nullst, es;
-
-    if(!(myFTEProtocolExtensions & FTE_PEXT_SPAWNSTATIC2))
-    {
-        myClient->onError("illegible server message\nsvc_fte_spawnbaseline2 without FTE_PEXT_SPAWNSTATIC2\n");
-        disconnect();
-        return;
-    }
+    memset(myStats, 0, sizeof(myStats));
+    myStatChanges = 0xffffffff;
+}
 
-    memset(&nullst, 0, sizeof (entityState_t));
-    memset(&es, 0, sizeof (entityState_t));
+const int* QWClientPrivate::stats() const
+{
+    return myStats;
+}
 
-    parseDelta(&nullst, &es, readShort());
+quint32 QWClientPrivate::statChanges() const
+{
+    return myStatChanges;
 }
 
-void QWClientPrivate::parseSvcQizmoVoice()
+void QWClientPrivate::clearStatChanges()
 {
-    // Read the two-byte header.
-    readByte();
-    readByte();
+    myStatChanges = 0;
+}
 
-    // 32 bytes of voice data follow
-    for(int i = 0; i < 32; i++)
-        readByte();
+void QWClientPrivate::setSnapshotPublishing(bool enabled)
+{
+    myPublishSnapshotsFlag = enabled;
 }
 
-void QWClientPrivate::parseSvcFTEVoiceChat()
+QWWorldSnapshot QWClientPrivate::snapshot() const
 {
-    readByte();
-    readByte();
-    readByte();
-    quint16 i = readShort();
-    myInStream.device()->seek(myInStream.device()->pos() + i);
+    QMutexLocker locker(&mySnapshotMutex);
+    return myCurrentSnapshot;
 }
 
-void QWClientPrivate::parseSvcFTESpawnStatic2()
+void QWClientPrivate::publishSnapshot()
 {
-    if(myFTEProtocolExtensions & FTE_PEXT_SPAWNSTATIC2)
+    QWWorldSnapshot::Data* data = NULL;
+
+    Q_STATIC_ASSERT(sizeof(data->players) == sizeof(myPlayers));
+    Q_STATIC_ASSERT(sizeof(data->scoreboard) == sizeof(myScoreboard));
+    Q_STATIC_ASSERT(sizeof(data->stats) == sizeof(myStats));
+
+    /* Reuse a snapshot only the pool holds, the current one is also held by myCurrentSnapshot */
+    for(int i = 0; i < mySnapshotPool.size(); ++i)
     {
-        entityState_t from, to;
-        memset(&from, 0, sizeof(entityState_t));
-        memset(&to, 0, sizeof(entityState_t));
-        parseDelta(&from, &to, readShort());
+        if(mySnapshotPool.at(i).d->ref.loadAcquire() == 1)
+        {
+            data = mySnapshotPool.at(i).d.data();
+            break;
+        }
+    }
+    if(!data)
+    {
+        data = new QWWorldSnapshot::Data;
+        mySnapshotPool.append(QWWorldSnapshot(data));
     }
-}
 
-void QWClientPrivate::parseSvcKilledMonster()
-{
+    data->sequence = myIncomingSeq;
+    data->time = myClock.elapsed();
+    memcpy(data->players, myPlayers, sizeof(myPlayers));
+    memcpy(data->scoreboard, myScoreboard, sizeof(myScoreboard));
+    memcpy(data->stats, myStats, sizeof(myStats));
+    data->entities = myEntityStore;
+    data->serverInfo = myServerInfo;
 
+    QWWorldSnapshot published(data);
+    mySnapshotMutex.lock();
+    myCurrentSnapshot = published;
+    mySnapshotMutex.unlock();
 }
 
-void QWClientPrivate::parseSvcFoundSecret()
+const QWSpatialIndex& QWClientPrivate::spatialIndex() const
 {
-
+    return mySpatialIndex;
 }
 
-void QWClientPrivate::parseSvcUpdateName()
+void QWClientPrivate::setPositionHistory(int snapshots)
 {
-    readByte();
-    readString();
+    myPositionHistory.resize(MAX_CLIENTS + MAX_EDICTS, snapshots);
 }
 
-void QWClientPrivate::parseSvcUpdateColors()
+qint64 QWClientPrivate::clock() const
 {
-    readByte();
-    readByte();
+    return myClock.elapsed();
 }
 
-void QWClientPrivate::parseSvcTime()
+bool QWClientPrivate::playerPositionAt(int playerNum, qint64 time, float *origin) const
 {
-    readFloat();
+    if(playerNum < 0 || playerNum >= MAX_CLIENTS)
+        return false;
+    return myPositionHistory.positionAt(playerNum, time, origin);
 }
 
-void QWClientPrivate::parseSvcSignonNum()
+bool QWClientPrivate::entityPositionAt(int number, qint64 time, float *origin) const
 {
-    readByte();
+    if(number < 0 || number >= MAX_EDICTS)
+        return false;
+    return myPositionHistory.positionAt(MAX_CLIENTS + number, time, origin);
 }
 
-void QWClientPrivate::parseSvcParticle()
+void QWClientPrivate::parseSvcNails()
 {
-    for(int i = 0; i < 3; ++i)
-        readCoord();
-    for(int i = 0; i < 3; ++i)
-        readByte();
-    readByte();
-    readByte();
+    parseNails(6);
 }
 
-void QWClientPrivate::parseSvcClientData()
+/*
+  Every record packs a projectile into 6 bytes, svc_nails2 prefixes each with its number:
+  12 bits per origin axis (2 units, biased by 4096), 4 bits of pitch, 8 bits of yaw.
+*/
+void QWClientPrivate::parseNails(int recordSize)
 {
-    qDebug() << "WHY?!?!?!?!?!?! WHY ME BEING CALLED!";
+    int count = readByte();
+
+    /* One bounds check for the whole message, then unpack straight from the datagram */
+    if(checkForBadRead(count * recordSize))
+        return;
+
+    int room = qMin(count, MaxProjectiles - myProjectileCount);
+    unpackNails(myInCursor, recordSize, room, myProjectiles + myProjectileCount);
+    myProjectileCount += room;
+    myInCursor += count * recordSize;
 }
 
-void QWClientPrivate::parseSvcVersion()
+void QWClientPrivate::unpackNails(const quint8 *records, int recordSize, int count, QWClient::Projectile *out)
 {
+    const bool indexed = recordSize == 7;
 
+    for(int i = 0; i < count; ++i, records += recordSize)
+    {
+        const quint8* bits = records + indexed;
+
+        out[i].index = indexed ? records[0] : -1;
+        out[i].origin[0] = ((bits[0] | (bits[1] & 15) << 8) << 1) - 4096;
+        out[i].origin[1] = (((bits[1] >> 4) | (bits[2] << 4)) << 1) - 4096;
+        out[i].origin[2] = ((bits[3] | (bits[4] & 15) << 8) << 1) - 4096;
+        out[i].angles[0] = (bits[4] >> 4) * (360.0f/16);
+        out[i].angles[1] = bits[5] * (360.0f/256);
+    }
 }
 
-void QWClientPrivate::preSpawn(int mapChecksum)
+int QWClientPrivate::projectileCount() const
 {
-    writeByte(&myReliableOutStream, clc_stringcmd);
-    writeString(&myReliableOutStream, "setinfo pmodel 33168");
+    return myProjectileCount;
+}
 
-    writeByte(&myReliableOutStream, clc_stringcmd);
+const QWClient::Projectile* QWClientPrivate::projectiles() const
+{
+    return myProjectiles;
+}
+
+void QWClientPrivate::parseSvcChokeCount()
+{
+    readByte();
+}
+
+void QWClientPrivate::parseSvcModellist()
+{
+    quint8 i = readByte();
+    bool	 firstLoop = true;
+    int    modelIndex = i;
+    for(;;)
+    {
+        QLatin1String s = readStringView();
+        if(s.isEmpty())
+            break;
+        modelIndex++;
+        if(!i && firstLoop)
+        {
+            myMapName = s;
+            firstLoop = false;
+        }
+        /* Players without PF_MODEL use the player model */
+        if(s == QLatin1String("progs/player.mdl"))
+            myPlayerModelIndex = modelIndex;
+        myClient->onModelListFile(s.data());
+    }
+    i = readByte();
+    if(i)
+    {
+        writeByte(&myReliableOutStream, clc_stringcmd);
+        writeString(&myReliableOutStream, QString("modellist " + QString::number(myServerCount) + " " + QString::number(i)));
+        return;
+    }
+
+    if(!fileExists(myMapName) && !QWTables::getOriginalMapChecksum(myMapName))
+    {
+        preSpawn(_mapChecksum);
+        return;
+    }
+    preSpawn(mapChecksum(myMapName));
+}
+
+void QWClientPrivate::parseSvcSoundlist()
+{
+    quint8 i;
+
+    i = readByte();
+    for(;;)
+    {
+        QLatin1String s = readStringView();
+        if(s.isEmpty())
+            break;
+        myClient->onSoundListFile(s.data());
+    }
+
+    i = readByte();
+    if(i)
+    {
+        writeByte(&myReliableOutStream, clc_stringcmd);
+        writeString(&myReliableOutStream, QString("soundlist " + QString::number(myServerCount) + " " + QString::number(i)));
+        return;
+    }
+
+    //continue login
+    writeByte(&myReliableOutStream, clc_stringcmd);
+    writeString(&myReliableOutStream, QString("modellist " + QString::number(myServerCount) + " 0"));
+}
+
+template<bool FloatCoords>
+void QWClientPrivate::parseSvcPacketEntities()
+{
+    parsePacketEntities<FloatCoords>(false);
+}
+
+template<bool FloatCoords>
+void QWClientPrivate::parseSvcDeltaPacketEntities()
+{
+    parsePacketEntities<FloatCoords>(true);
+}
+
+/*
+  An svc_packetentities message is a full update that later deltas can start from,
+  svc_deltapacketentities carries only the differences against an older frame.
+  Both come as a list of entity deltas sorted by entity number and terminated by 0.
+*/
+template<bool FloatCoords>
+void QWClientPrivate::parsePacketEntities(bool delta)
+{
+    int                 oldIndex, newIndex;
+    int                 word, newNum, oldNum;
+    bool                full;
+    packetEntities_t*   oldp;
+    packetEntities_t    dummy;
+    EntityFrame&        frame = myEntityFrames[myIncomingSeq & UPDATE_MASK];
+    packetEntities_t*   newp = &frame.packetEntities;
+
+    frame.invalid = false;
+    myPlayerFrameFlag = true;
+
+    if(delta)
+    {
+        quint8 from = readByte();
+        int oldPacket = frame.deltaSequence;
+        quint32 newest = myOutgoingSeq;
+
+        /* A replayed capture has no requests of ours, the base is the frame the server names */
+        if(myReplayFlag)
+        {
+            oldPacket = myIncomingSeq - ((myIncomingSeq - from) & 0xff);
+            newest = myIncomingSeq;
+        }
+
+        /* There are no valid frames left, too old or not the one we asked for */
+        if(oldPacket < 0 ||
+           newest - myIncomingSeq >= UPDATE_BACKUP - 1 ||
+           (from & UPDATE_MASK) != (oldPacket & UPDATE_MASK) ||
+           newest - (quint32)oldPacket >= UPDATE_BACKUP - 1)
+        {
+            flushEntityPacket();
+            myValidSequence = 0;
+            return;
+        }
+        oldp = &myEntityFrames[oldPacket & UPDATE_MASK].packetEntities;
+        full = false;
+    }
+    else
+    {
+        dummy.numentities = 0;
+        oldp = &dummy;
+        full = true;
+    }
+
+    myValidSequence = myIncomingSeq;
+
+    oldIndex = 0;
+    newIndex = 0;
+    newp->numentities = 0;
+
+    for(;;)
+    {
+        word = (unsigned short)readShort();
+        if(myBadReadFlag)
+        {
+            frame.invalid = true;
+            myValidSequence = 0;
+            return;
+        }
+
+        if(!word)
+        {
+            /* Copy all the rest of the entities from the old packet */
+            while(oldIndex < oldp->numentities && newIndex < MAX_PACKET_ENTITIES)
+                newp->entities[newIndex++] = oldp->entities[oldIndex++];
+            break;
+        }
+
+        newNum = peekEntityNumber(word);
+        oldNum = oldIndex >= oldp->numentities ? 9999 : oldp->entities[oldIndex].number;
+
+        /* Entities the server didn't mention are unchanged */
+        while(newNum > oldNum && newIndex < MAX_PACKET_ENTITIES)
+        {
+            newp->entities[newIndex++] = oldp->entities[oldIndex++];
+            oldNum = oldIndex >= oldp->numentities ? 9999 : oldp->entities[oldIndex].number;
+        }
+
+        if(newIndex >= MAX_PACKET_ENTITIES && !(word & U_REMOVE))
+        {
+            myClient->onError("Too many packet entities from server.");
+            flushEntityPacket();
+            myValidSequence = 0;
+            return;
+        }
+
+        if(newNum < oldNum)
+        {
+            /* New entity, delta from the baseline */
+            if(word & U_REMOVE)
+            {
+                if(full)
+                {
+                    flushEntityPacket();
+                    myValidSequence = 0;
+                    return;
+                }
+                /* Removes of entities past 511 still carry the extension bytes */
+                skipDelta(word);
+                continue;
+            }
+            if(newNum >= MAX_EDICTS)
+            {
+                myClient->onError("Entity number out of range from server.");
+                flushEntityPacket();
+                myValidSequence = 0;
+                return;
+            }
+            parseDelta<FloatCoords>(&myBaselines[newNum], &newp->entities[newIndex], word);
+            newIndex++;
+            continue;
+        }
+
+        if(newNum == oldNum)
+        {
+            /* Delta from the previous frame */
+            if(full)
+                myValidSequence = 0;
+
+            if(word & U_REMOVE)
+            {
+                skipDelta(word);
+                oldIndex++;
+                continue;
+            }
+            parseDelta<FloatCoords>(&oldp->entities[oldIndex], &newp->entities[newIndex], word);
+            newIndex++;
+            oldIndex++;
+        }
+    }
+
+    newp->numentities = newIndex;
+    fillEntityStore(newp);
+}
+
+void QWClientPrivate::fillEntityStore(const packetEntities_t *entities)
+{
+    QWEntityStore& store = myEntityStore;
+
+    Q_STATIC_ASSERT(QWEntityStore::Capacity >= MAX_PACKET_ENTITIES);
+    store.myCount = entities->numentities;
+    for(int i = 0; i < entities->numentities; ++i)
+    {
+        const entityState_t& e = entities->entities[i];
+        store.myNumbers[i] = e.number;
+        store.myOriginX[i] = e.origin[0];
+        store.myOriginY[i] = e.origin[1];
+        store.myOriginZ[i] = e.origin[2];
+        store.myPitch[i] = e.angles[0];
+        store.myYaw[i] = e.angles[1];
+        store.myRoll[i] = e.angles[2];
+        store.myModelIndices[i] = e.modelindex;
+        store.myFrames[i] = e.frame;
+        store.myColorMaps[i] = e.colormap;
+        store.mySkinNums[i] = e.skinnum;
+        store.myEffects[i] = e.effects;
+        store.myFlags[i] = e.flags;
+    }
+    mySpatialIndex.setEntities(store);
+
+    if(myPositionHistory.depth())
+    {
+        qint64 now = myClock.elapsed();
+        for(int i = 0; i < entities->numentities; ++i)
+            myPositionHistory.record(MAX_CLIENTS + entities->entities[i].number, now, entities->entities[i].origin);
+    }
+}
+
+void QWClientPrivate::flushEntityPacket()
+{
+    myEntityFrames[myIncomingSeq & UPDATE_MASK].invalid = true;
+    skipSvcPacketEntities();
+}
+
+void QWClientPrivate::resetEntityFrames()
+{
+    for(int i = 0; i < UPDATE_BACKUP; ++i)
+    {
+        myEntityFrames[i].packetEntities.numentities = 0;
+        myEntityFrames[i].deltaSequence = -1;
+        myEntityFrames[i].invalid = true;
+    }
+    myValidSequence = 0;
+    myEntityStore.clear();
+    mySpatialIndex.clearEntities();
+}
+
+const QWEntityStore& QWClientPrivate::entityStore() const
+{
+    return myEntityStore;
+}
+
+const packetEntities_t* QWClientPrivate::currentEntities() const
+{
+    if(!myValidSequence)
+        return NULL;
+
+    const EntityFrame& frame = myEntityFrames[myValidSequence & UPDATE_MASK];
+    return frame.invalid ? NULL : &frame.packetEntities;
+}
+
+int QWClientPrivate::entityCount() const
+{
+    const packetEntities_t* entities = currentEntities();
+    return entities ? entities->numentities : 0;
+}
+
+static QWClient::EntityState toEntityState(const entityState_t& e)
+{
+    QWClient::EntityState state;
+
+    state.number = e.number;
+    for(int i = 0; i < 3; ++i)
+    {
+        state.origin[i] = e.origin[i];
+        state.angles[i] = e.angles[i];
+    }
+    state.modelIndex = e.modelindex;
+    state.frame = e.frame;
+    state.colorMap = e.colormap;
+    state.skinNum = e.skinnum;
+    state.effects = e.effects;
+    return state;
+}
+
+QWClient::EntityState QWClientPrivate::entity(int index) const
+{
+    entityState_t empty;
+    const packetEntities_t* entities = currentEntities();
+
+    if(!entities || index < 0 || index >= entities->numentities)
+    {
+        memset(&empty, 0, sizeof(empty));
+        return toEntityState(empty);
+    }
+    return toEntityState(entities->entities[index]);
+}
+
+QWClient::EntityState QWClientPrivate::baseline(int number) const
+{
+    entityState_t empty;
+
+    if(number < 0 || number >= MAX_EDICTS)
+    {
+        memset(&empty, 0, sizeof(empty));
+        return toEntityState(empty);
+    }
+    return toEntityState(myBaselines[number]);
+}
+
+int QWClientPrivate::staticEntityCount() const
+{
+    return myStaticEntities.size();
+}
+
+QWClient::EntityState QWClientPrivate::staticEntity(int index) const
+{
+    entityState_t empty;
+
+    if(index < 0 || index >= myStaticEntities.size())
+    {
+        memset(&empty, 0, sizeof(empty));
+        return toEntityState(empty);
+    }
+    return toEntityState(myStaticEntities.at(index));
+}
+
+void QWClientPrivate::resetBaselines()
+{
+    memset(myBaselines, 0, sizeof(myBaselines));
+    for(int i = 0; i < MAX_EDICTS; ++i)
+        myBaselines[i].number = i;
+    myStaticEntities.clear();
+}
+
+void QWClientPrivate::parseSvcMaxSpeed()
+{
+    float maxSpeed = readFloat();
+
+    if(myBatchEventsFlag)
+        appendEvent(QWClient::MaxSpeedEvent)->vector[0] = maxSpeed;
+    else
+        myClient->onMaxSpeedChange(maxSpeed);
+}
+
+void QWClientPrivate::parseSvcEntGravity()
+{
+    float entGravity = readFloat();
+
+    if(myBatchEventsFlag)
+        appendEvent(QWClient::EntGravityEvent)->vector[0] = entGravity;
+    else
+        myClient->onEntGravityChange(entGravity);
+}
+
+void QWClientPrivate::parseSvcSetPause()
+{
+    bool paused = readByte();
+
+    if(myBatchEventsFlag)
+        appendEvent(QWClient::PauseEvent)->value = paused;
+    else
+        myClient->onSetPause(paused);
+}
+
+void QWClientPrivate::parseSvcNails2()
+{
+    parseNails(7);
+}
+
+void QWClientPrivate::parseSvcFTEModellistShort()
+{
+    quint16 i = readShort();
+    bool	  firstLoop = true;
+    int     modelIndex = i;
+    for(;;)
+    {
+        QLatin1String s = readStringView();
+        if(s.isEmpty())
+            break;
+        modelIndex++;
+        if(!i && firstLoop)
+        {
+            myMapName = s;
+            firstLoop = false;
+        }
+        /* Players without PF_MODEL use the player model */
+        if(s == QLatin1String("progs/player.mdl"))
+            myPlayerModelIndex = modelIndex;
+        myClient->onModelListFile(s.data());
+    }
+    i = readByte();
+    if(i)
+    {
+        writeByte(&myReliableOutStream, clc_stringcmd);
+        writeString(&myReliableOutStream, QString("modellist " + QString::number(myServerCount) + " " + QString::number(i)));
+        return;
+    }
+
+    if(!fileExists(myMapName) && !QWTables::getOriginalMapChecksum(myMapName))
+    {
+        startDownload(myMapName);
+        return;
+    }
+    preSpawn(mapChecksum(myMapName));
+}
+
+void QWClientPrivate::parseSvcFTESpawnBaseline2()
+{
+    entityState_t nullst, es;
+
+    if(!(myFTEProtocolExtensions & FTE_PEXT_SPAWNSTATIC2))
+    {
+        myClient->onError("illegible server message\nsvc_fte_spawnbaseline2 without FTE_PEXT_SPAWNSTATIC2\n");
+        disconnect();
+        return;
+    }
+
+    memset(&nullst, 0, sizeof (entityState_t));
+    memset(&es, 0, sizeof (entityState_t));
+
+    parseDelta(&nullst, &es, (unsigned short)readShort());
+    if(es.number < MAX_EDICTS && !myBadReadFlag)
+        myBaselines[es.number] = es;
+}
+
+void QWClientPrivate::parseSvcQizmoVoice()
+{
+    // Read the two-byte header.
+    readByte();
+    readByte();
+
+    // 32 bytes of voice data follow
+    for(int i = 0; i < 32; i++)
+        readByte();
+}
+
+void QWClientPrivate::parseSvcFTEVoiceChat()
+{
+    readByte();
+    readByte();
+    readByte();
+    quint16 i = readShort();
+    skipBytes(i);
+}
+
+void QWClientPrivate::parseSvcFTESpawnStatic2()
+{
+    if(myFTEProtocolExtensions & FTE_PEXT_SPAWNSTATIC2)
+    {
+        entityState_t from, to;
+        memset(&from, 0, sizeof(entityState_t));
+        memset(&to, 0, sizeof(entityState_t));
+        parseDelta(&from, &to, (unsigned short)readShort());
+        if(!myBadReadFlag)
+            myStaticEntities.append(to);
+    }
+}
+
+void QWClientPrivate::parseSvcKilledMonster()
+{
+
+}
+
+void QWClientPrivate::parseSvcFoundSecret()
+{
+
+}
+
+void QWClientPrivate::parseSvcUpdateName()
+{
+    readByte();
+    readStringView();
+}
+
+void QWClientPrivate::parseSvcUpdateColors()
+{
+    readByte();
+    readByte();
+}
+
+void QWClientPrivate::parseSvcTime()
+{
+    readFloat();
+}
+
+void QWClientPrivate::parseSvcSignonNum()
+{
+    readByte();
+}
+
+void QWClientPrivate::parseSvcParticle()
+{
+    for(int i = 0; i < 3; ++i)
+        readCoord();
+    for(int i = 0; i < 3; ++i)
+        readByte();
+    readByte();
+    readByte();
+}
+
+void QWClientPrivate::parseSvcClientData()
+{
+    qDebug() << "WHY?!?!?!?!?!?! WHY ME BEING CALLED!";
+}
+
+void QWClientPrivate::parseSvcVersion()
+{
+
+}
+
+void QWClientPrivate::preSpawn(int mapChecksum)
+{
+    writeByte(&myReliableOutStream, clc_stringcmd);
+    writeString(&myReliableOutStream, "setinfo pmodel 33168");
+
+    writeByte(&myReliableOutStream, clc_stringcmd);
     writeString(&myReliableOutStream, "setinfo emodel 6967");
 
     writeByte(&myReliableOutStream, clc_stringcmd);
     writeString(&myReliableOutStream, QString("prespawn " + QString::number(myServerCount) + " 0 " + QString::number(mapChecksum)));
 }
 
-void QWClientPrivate::parseServerMessage()
+bool QWClientPrivate::acceptMessage()
 {
     quint32 incomingSeq, incomingAck;
     bool		incomingSeqReliable, incomingAckReliable;
 
     myBadReadFlag = false;
 
-    myInStream.device()->seek(0);
-    myInStream >> incomingSeq;
-    myInStream >> incomingAck;
+    myInCursor = myInBegin;
+    incomingSeq = readLong();
+    incomingAck = readLong();
     incomingSeqReliable = incomingSeq >> 31;
     incomingAckReliable = incomingAck >> 31;
     incomingSeq &= ~0x80000000;
     incomingAck &= ~0x80000000;
 
     if(incomingSeq <= myIncomingSeq)
-        return;
+        return false;
 
     myPacketLoss = incomingSeq - (myIncomingSeq + 1);
 
@@ -1645,8 +2647,13 @@ void QWClientPrivate::parseServerMessage()
     myIncomingSeq = incomingSeq;
     myIncomingAck = incomingAck;
     myIncomingAckReliableFlag = incomingAckReliable;
+    return true;
+}
 
-    while(!myInStream.atEnd())
+void QWClientPrivate::parseServerMessage()
+{
+    quint8 last = 0;
+    while(myInCursor < myInEnd)
     {
         if(myBadReadFlag)
         {
@@ -1655,247 +2662,474 @@ void QWClientPrivate::parseServerMessage()
             return;
         }
 
-        quint8 c;
-        quint8 last = 0;
-
-        myInStream >> c;
+        const quint8* start = myInCursor;
+        quint8 c = *myInCursor++;
         if(c == 0xff)
             break;
 
-        switch(c)
+        if(c == svc_bad)
         {
-        case svc_bad:
             myClient->onError("Bad read from server.");
             disconnect();
             return;
+        }
 
-        case svc_nop:
-            parseSvcNoop();
-            break;
-
-        case svc_disconnect:
-            parseSvcDisconnect();
-            break;
-
-        case svc_print:
-            parseSvcPrint();
-            break;
-
-        case svc_centerprint:
-            parseSvcCenterPrint();
-            break;
+        const SvcParser& parser = mySvcParsers[c];
+        ParseFunction parse = parser.parse;
+        if(!parse)
+        {
+            myClient->onError(QString("Unknown message from server. Last Cmd: [" + QString::number(last) + "] Current Cmd: [" + QString::number(c) + "]").toLatin1().data());
+            disconnect();
+            return;
+        }
 
-        case svc_stufftext:
-            parseSvcStuffText();
-            break;
+        QWClient::MessageStats& stats = myMessageStats[c];
+        if(myIgnoredMessages[c >> 5] & (1u << (c & 31)))
+        {
+            if(parser.skip)
+                (this->*parser.skip)();
+            else
+                skipBytes(parser.size);
+            stats.count++;
+            stats.bytes += myInCursor - start;
+            last = c;
+            continue;
+        }
 
-        case svc_damage:
-            parseSvcDamage();
-            break;
+        if(myMessageTimingFlag)
+        {
+            quint64 allocationsStart = myAllocationCounter ? *myAllocationCounter : 0;
+            qint64 parseStart = myClock.nsecsElapsed();
+            (this->*parse)();
+            stats.nsecs += myClock.nsecsElapsed() - parseStart;
+            if(myAllocationCounter)
+                stats.allocations += *myAllocationCounter - allocationsStart;
+        }
+        else
+        {
+            (this->*parse)();
+        }
+        stats.count++;
+        stats.bytes += myInCursor - start;
 
-        case svc_serverdata:
-            parseSvcServerData();
-            break;
+        last = c;
+    }
+}
 
-        case svc_setangle:
-            parseSvcSetAngle();
-            break;
+//========================================================================
+// Dispatch table and statistics
+
+QWClientPrivate::SvcParser QWClientPrivate::ourSvcParsers[2][256];
+bool QWClientPrivate::ourSvcParsersFilled = QWClientPrivate::fillSvcParsers();
+
+bool QWClientPrivate::fillSvcParsers()
+{
+    setSvcParser(svc_nop, &QWClientPrivate::parseSvcNoop, "svc_nop");
+    setSvcParser(svc_disconnect, &QWClientPrivate::parseSvcDisconnect, "svc_disconnect");
+    setSvcParser(svc_print, &QWClientPrivate::parseSvcPrint, "svc_print");
+    setSvcParser(svc_centerprint, &QWClientPrivate::parseSvcCenterPrint, "svc_centerprint");
+    setSvcParser(svc_stufftext, &QWClientPrivate::parseSvcStuffText, "svc_stufftext");
+    setSvcParser(svc_damage, &QWClientPrivate::parseSvcDamage, "svc_damage");
+    setSvcParser(svc_serverdata, &QWClientPrivate::parseSvcServerData, "svc_serverdata");
+    setSvcParser(svc_setangle, &QWClientPrivate::parseSvcSetAngle, "svc_setangle");
+    setSvcParser(svc_lightstyle, &QWClientPrivate::parseSvcLightStyle, "svc_lightstyle");
+    setSvcParser(svc_sound, &QWClientPrivate::parseSvcSound<false>, &QWClientPrivate::parseSvcSound<true>, "svc_sound");
+    setSvcParser(svc_stopsound, &QWClientPrivate::parseSvcStopSound, "svc_stopsound");
+    setSvcParser(svc_updatefrags, &QWClientPrivate::parseSvcUpdateFrags, "svc_updatefrags");
+    setSvcParser(svc_updateping, &QWClientPrivate::parseSvcUpdatePing, "svc_updateping");
+    setSvcParser(svc_updatepl, &QWClientPrivate::parseSvcUpdatePL, "svc_updatepl");
+    setSvcParser(svc_updateentertime, &QWClientPrivate::parseSvcUpdateEnterTime, "svc_updateentertime");
+    setSvcParser(svc_spawnbaseline, &QWClientPrivate::parseSvcSpawnBaseLine, "svc_spawnbaseline");
+    setSvcParser(svc_spawnstatic, &QWClientPrivate::parseSvcSpawnStatic, "svc_spawnstatic");
+    setSvcParser(svc_temp_entity, &QWClientPrivate::parseSvcTempEntity<false>, &QWClientPrivate::parseSvcTempEntity<true>, "svc_temp_entity");
+    setSvcParser(svc_killedmonster, &QWClientPrivate::parseSvcKilledMonster, "svc_killedmonster");
+    setSvcParser(svc_foundsecret, &QWClientPrivate::parseSvcFoundSecret, "svc_foundsecret");
+    setSvcParser(svc_updatestat, &QWClientPrivate::parseSvcUpdateStat, "svc_updatestat");
+    setSvcParser(svc_updatestatlong, &QWClientPrivate::parseSvcUpdateStatLong, "svc_updatestatlong");
+    setSvcParser(svc_spawnstaticsound, &QWClientPrivate::parseSvcSpawnStaticSound, "svc_spawnstaticsound");
+    setSvcParser(svc_cdtrack, &QWClientPrivate::parseSvcCDTrack, "svc_cdtrack");
+    setSvcParser(svc_intermission, &QWClientPrivate::parseSvcIntermission, "svc_intermission");
+    setSvcParser(svc_finale, &QWClientPrivate::parseSvcFinale, "svc_finale");
+    setSvcParser(svc_sellscreen, &QWClientPrivate::parseSvcSellScreen, "svc_sellscreen");
+    setSvcParser(svc_smallkick, &QWClientPrivate::parseSvcSmallKick, "svc_smallkick");
+    setSvcParser(svc_bigkick, &QWClientPrivate::parseSvcBigKick, "svc_bigkick");
+    setSvcParser(svc_muzzleflash, &QWClientPrivate::parseSvcMuzzleFlash, "svc_muzzleflash");
+    setSvcParser(svc_updateuserinfo, &QWClientPrivate::parseSvcUpdateUserinfo, "svc_updateuserinfo");
+    setSvcParser(svc_setinfo, &QWClientPrivate::parseSvcSetinfo, "svc_setinfo");
+    setSvcParser(svc_serverinfo, &QWClientPrivate::parseSvcServerinfo, "svc_serverinfo");
+    setSvcParser(svc_download, &QWClientPrivate::parseSvcDownload, "svc_download");
+    setSvcParser(svc_playerinfo, &QWClientPrivate::parseSvcPlayerinfo<false>, &QWClientPrivate::parseSvcPlayerinfo<true>, "svc_playerinfo");
+    setSvcParser(svc_nails, &QWClientPrivate::parseSvcNails, "svc_nails");
+    setSvcParser(svc_chokecount, &QWClientPrivate::parseSvcChokeCount, "svc_chokecount");
+    setSvcParser(svc_modellist, &QWClientPrivate::parseSvcModellist, "svc_modellist");
+    setSvcParser(svc_soundlist, &QWClientPrivate::parseSvcSoundlist, "svc_soundlist");
+    setSvcParser(svc_packetentities, &QWClientPrivate::parseSvcPacketEntities<false>, &QWClientPrivate::parseSvcPacketEntities<true>, "svc_packetentities");
+    setSvcParser(svc_deltapacketentities, &QWClientPrivate::parseSvcDeltaPacketEntities<false>, &QWClientPrivate::parseSvcDeltaPacketEntities<true>, "svc_deltapacketentities");
+    setSvcParser(svc_maxspeed, &QWClientPrivate::parseSvcMaxSpeed, "svc_maxspeed");
+    setSvcParser(svc_entgravity, &QWClientPrivate::parseSvcEntGravity, "svc_entgravity");
+    setSvcParser(svc_setpause, &QWClientPrivate::parseSvcSetPause, "svc_setpause");
+    setSvcParser(svc_nails2, &QWClientPrivate::parseSvcNails2, "svc_nails2");
+    setSvcParser(svc_fte_modellistshort, &QWClientPrivate::parseSvcFTEModellistShort, "svc_fte_modellistshort");
+    setSvcParser(svc_fte_spawnbaseline2, &QWClientPrivate::parseSvcFTESpawnBaseline2, "svc_fte_spawnbaseline2");
+    setSvcParser(svc_qizmovoice, &QWClientPrivate::parseSvcQizmoVoice, "svc_qizmovoice");
+    setSvcParser(svc_fte_voicechat, &QWClientPrivate::parseSvcFTEVoiceChat, "svc_fte_voicechat");
+    setSvcParser(svc_fte_spawnstatic2, &QWClientPrivate::parseSvcFTESpawnStatic2, "svc_fte_spawnstatic2");
+    setSvcParser(nq_svc_time, &QWClientPrivate::parseSvcTime, "nq_svc_time");
+    setSvcParser(nq_svc_clientdata, &QWClientPrivate::parseSvcClientData, "nq_svc_clientdata");
+    setSvcParser(nq_svc_version, &QWClientPrivate::parseSvcVersion, "nq_svc_version");
+    setSvcParser(nq_svc_particle, &QWClientPrivate::parseSvcParticle, "nq_svc_particle");
+    setSvcParser(nq_svc_signonnum, &QWClientPrivate::parseSvcSignonNum, "nq_svc_signonnum");
+    setSvcParser(nq_svc_updatecolors, &QWClientPrivate::parseSvcUpdateColors, "nq_svc_updatecolors");
+    setSvcParser(nq_svc_updatename, &QWClientPrivate::parseSvcUpdateName, "nq_svc_updatename");
+
+    /* Messages that can be skipped when nobody is interested, everything
+       needed to connect, download and follow the server stays out of here */
+    setSvcLayout(svc_damage, 2, 3, 0);
+    setSvcLayout(svc_setangle, 0, 0, 3);
+    setSvcLayout(svc_stopsound, 2, 0, 0);
+    setSvcLayout(svc_updatefrags, 3, 0, 0);
+    setSvcLayout(svc_updateping, 3, 0, 0);
+    setSvcLayout(svc_updatepl, 2, 0, 0);
+    setSvcLayout(svc_updateentertime, 5, 0, 0);
+    setSvcLayout(svc_spawnbaseline, 6, 3, 3);
+    setSvcLayout(svc_spawnstatic, 4, 3, 3);
+    setSvcLayout(svc_updatestat, 2, 0, 0);
+    setSvcLayout(svc_updatestatlong, 5, 0, 0);
+    setSvcLayout(svc_spawnstaticsound, 3, 3, 0);
+    setSvcLayout(svc_cdtrack, 1, 0, 0);
+    setSvcLayout(svc_intermission, 0, 3, 3);
+    setSvcLayout(svc_muzzleflash, 2, 0, 0);
+    setSvcLayout(svc_chokecount, 1, 0, 0);
+    setSvcLayout(svc_maxspeed, 4, 0, 0);
+    setSvcLayout(svc_entgravity, 4, 0, 0);
+    setSvcLayout(svc_setpause, 1, 0, 0);
+    setSvcLayout(svc_qizmovoice, 34, 0, 0);
+    setSvcLayout(svc_smallkick, 0, 0, 0);
+    setSvcLayout(svc_bigkick, 0, 0, 0);
+    setSvcLayout(svc_killedmonster, 0, 0, 0);
+    setSvcLayout(svc_foundsecret, 0, 0, 0);
+    setSvcLayout(svc_sellscreen, 0, 0, 0);
+    setSvcSkip(svc_sound, &QWClientPrivate::skipSvcSound);
+    setSvcSkip(svc_temp_entity, &QWClientPrivate::skipSvcTempEntity);
+    setSvcSkip(svc_nails, &QWClientPrivate::skipSvcNails);
+    setSvcSkip(svc_nails2, &QWClientPrivate::skipSvcNails2);
+    setSvcSkip(svc_playerinfo, &QWClientPrivate::skipSvcPlayerinfo);
+    setSvcSkip(svc_packetentities, &QWClientPrivate::skipSvcPacketEntities);
+    setSvcSkip(svc_deltapacketentities, &QWClientPrivate::skipSvcDeltaPacketEntities);
+    setSvcSkip(svc_fte_spawnbaseline2, &QWClientPrivate::skipSvcFTESpawnBaseline2);
+    setSvcSkip(svc_fte_spawnstatic2, &QWClientPrivate::skipSvcFTESpawnStatic2);
+    setSvcSkip(svc_lightstyle, &QWClientPrivate::skipSvcLightStyle);
+    setSvcSkip(svc_centerprint, &QWClientPrivate::skipSvcString);
+    setSvcSkip(svc_finale, &QWClientPrivate::skipSvcString);
+    setSvcSkip(svc_serverinfo, &QWClientPrivate::skipSvcServerinfo);
+    setSvcSkip(svc_updateuserinfo, &QWClientPrivate::skipSvcUpdateUserinfo);
+    setSvcSkip(svc_fte_voicechat, &QWClientPrivate::skipSvcFTEVoiceChat);
+
+    return true;
+}
+
+void QWClientPrivate::setSvcParser(quint8 svc, ParseFunction parse, const char *name)
+{
+    setSvcParser(svc, parse, parse, name);
+}
+
+void QWClientPrivate::setSvcParser(quint8 svc, ParseFunction parse, ParseFunction parseFloatCoords, const char *name)
+{
+    ourSvcParsers[0][svc] = SvcParser(parse, name);
+    ourSvcParsers[1][svc] = SvcParser(parseFloatCoords, name);
+}
+
+void QWClientPrivate::setSvcSkip(quint8 svc, ParseFunction skip)
+{
+    for(int i = 0; i < 2; ++i)
+    {
+        ourSvcParsers[i][svc].skip = skip;
+        ourSvcParsers[i][svc].skippable = true;
+    }
+}
 
-        case svc_lightstyle:
-            parseSvcLightStyle();
-            break;
+void QWClientPrivate::setSvcLayout(quint8 svc, quint8 bytes, quint8 coords, quint8 angles)
+{
+    /* Legacy coords are shorts and angles bytes, float coords sessions use floats and shorts */
+    ourSvcParsers[0][svc].size = bytes + coords * 2 + angles;
+    ourSvcParsers[0][svc].skippable = true;
+    ourSvcParsers[1][svc].size = bytes + coords * 4 + angles * 2;
+    ourSvcParsers[1][svc].skippable = true;
+}
 
-        case svc_sound:
-            parseSvcSound();
-            break;
+void QWClientPrivate::selectSvcParsers()
+{
+    mySvcParsers = ourSvcParsers[(myFTEProtocolExtensions & FTE_PEXT_FLOATCOORDS) ? 1 : 0];
+}
 
-        case svc_stopsound:
-            parseSvcStopSound();
-            break;
+bool QWClientPrivate::messageSkippable(quint8 svc)
+{
+    return ourSvcParsers[0][svc].skippable;
+}
 
-        case svc_updatefrags:
-            parseSvcUpdateFrags();
-            break;
+void QWClientPrivate::setMessageInterest(quint8 svc, bool interested)
+{
+    if(!ourSvcParsers[0][svc].skippable)
+        return;
 
-        case svc_updateping:
-            parseSvcUpdatePing();
-            break;
+    if(interested)
+    {
+        myIgnoredMessages[svc >> 5] &= ~(1u << (svc & 31));
+    }
+    else
+    {
+        myIgnoredMessages[svc >> 5] |= 1u << (svc & 31);
 
-        case svc_updatepl:
-            parseSvcUpdatePL();
-            break;
+        /* Skipped entity updates leave the frames stale */
+        if(svc == svc_packetentities || svc == svc_deltapacketentities)
+            resetEntityFrames();
+    }
+}
 
-        case svc_updateentertime:
-            parseSvcUpdateEnterTime();
-            break;
+bool QWClientPrivate::messageInterest(quint8 svc) const
+{
+    return !(myIgnoredMessages[svc >> 5] & (1u << (svc & 31)));
+}
 
-        case svc_spawnbaseline:
-            parseSvcSpawnBaseLine();
-            break;
+//========================================================================
+// Skippers, they only compute message lengths
 
-        case svc_spawnstatic:
-            parseSvcSpawnStatic();
-            break;
+void QWClientPrivate::skipString()
+{
+    readStringView();
+}
 
-        case svc_temp_entity:
-            parseSvcTempEntity();
-            break;
+void QWClientPrivate::skipUserDeltaCmd()
+{
+    quint8 bits = readByte();
+    int size = 1; //msec
 
-        case svc_killedmonster:
-            parseSvcKilledMonster();
-            break;
+    if(bits & CM_ANGLE1)
+        size += 2;
+    if(bits & CM_ANGLE2)
+        size += 2;
+    if(bits & CM_ANGLE3)
+        size += 2;
+    if(bits & CM_FORWARD)
+        size += 2;
+    if(bits & CM_SIDE)
+        size += 2;
+    if(bits & CM_UP)
+        size += 2;
+    if(bits & CM_BUTTONS)
+        size++;
+    if(bits & CM_IMPULSE)
+        size++;
 
-        case svc_foundsecret:
-            parseSvcFoundSecret();
-            break;
+    skipBytes(size);
+}
 
-        case svc_updatestat:
-            parseSvcUpdateStat();
-            break;
+void QWClientPrivate::skipDelta(int bits)
+{
+    int morebits = 0;
+    int size = 0;
 
-        case svc_updatestatlong:
-            parseSvcUpdateStatLong();
-            break;
+    bits &= ~511;
+    if(bits & U_MOREBITS)
+        bits |= readByte();
 
-        case svc_spawnstaticsound:
-            parseSvcSpawnStaticSound();
-            break;
+    if(bits & U_FTE_EVENMORE && myFTEProtocolExtensions)
+    {
+        morebits = readByte();
+        if (morebits & U_FTE_YETMORE)
+            morebits |= readByte() << 8;
+    }
 
-        case svc_cdtrack:
-            parseSvcCDTrack();
-            break;
+    if(bits & U_MODEL)
+        size++;
+    if(bits & U_FRAME)
+        size++;
+    if(bits & U_COLORMAP)
+        size++;
+    if(bits & U_SKIN)
+        size++;
+    if(bits & U_EFFECTS)
+        size++;
+    if(bits & U_ORIGIN1)
+        size += coordSize();
+    if(bits & U_ANGLE1)
+        size += angleSize();
+    if(bits & U_ORIGIN2)
+        size += coordSize();
+    if(bits & U_ANGLE2)
+        size += angleSize();
+    if(bits & U_ORIGIN3)
+        size += coordSize();
+    if(bits & U_ANGLE3)
+        size += angleSize();
+    if(morebits & U_FTE_TRANS && myFTEProtocolExtensions & FTE_PEXT_TRANS)
+        size++;
 
-        case svc_intermission:
-            parseSvcIntermission();
-            break;
+    skipBytes(size);
+}
 
-        case svc_finale:
-            parseSvcFinale();
-            break;
+void QWClientPrivate::skipSvcSound()
+{
+    quint16 channel = readShort();
+    int size = 1 + 3 * coordSize();
 
-        case svc_sellscreen:
-            parseSvcSellScreen();
-            break;
+    if (channel & SND_VOLUME)
+        size++;
+    if (channel & SND_ATTENUATION)
+        size++;
+    skipBytes(size);
+}
 
-        case svc_smallkick:
-            parseSvcSmallKick();
-            break;
+void QWClientPrivate::skipSvcTempEntity()
+{
+    switch(readByte())
+    {
+    case TE_LIGHTNING1:
+    case TE_LIGHTNING2:
+    case TE_LIGHTNING3:
+        skipBytes(2 + 6 * coordSize());
+        break;
 
-        case svc_bigkick:
-            parseSvcBigKick();
-            break;
+    case TE_GUNSHOT:
+    case TE_BLOOD:
+        skipBytes(1 + 3 * coordSize());
+        break;
 
-        case svc_muzzleflash:
-            parseSvcMuzzleFlash();
-            break;
+    default:
+        skipBytes(3 * coordSize());
+        break;
+    }
+}
 
-        case svc_updateuserinfo:
-            parseSvcUpdateUserinfo();
-            break;
+void QWClientPrivate::skipSvcNails()
+{
+    skipBytes(readByte() * 6);
+}
 
-        case svc_setinfo:
-            parseSvcSetinfo();
-            break;
+void QWClientPrivate::skipSvcNails2()
+{
+    skipBytes(readByte() * 7);
+}
 
-        case svc_serverinfo:
-            parseSvcServerinfo();
-            break;
+void QWClientPrivate::skipSvcPlayerinfo()
+{
+    readByte();
+    quint16 flags = readShort();
+    int size = 3 * coordSize() + 1;
 
-        case svc_download:
-            parseSvcDownload();
-            break;
+    if(flags & PF_MSEC)
+        size++;
+    skipBytes(size);
 
-        case svc_playerinfo:
-            parseSvcPlayerinfo();
-            break;
+    if(flags & PF_COMMAND)
+        skipUserDeltaCmd();
 
-        case svc_nails:
-            parseSvcNails();
-            break;
+    size = 0;
+    for(int i = 0; i < 3; i++)
+    {
+        if(flags & (PF_VELOCITY1<<i))
+            size += 2;
+    }
+    if(flags & PF_MODEL)
+        size++;
+    if(flags & PF_SKINNUM)
+        size++;
+    if(flags & PF_EFFECTS)
+        size++;
+    if(flags & PF_WEAPONFRAME)
+        size++;
+    if(flags & PF_TRANS_Z && myFTEProtocolExtensions & FTE_PEXT_TRANS)
+        size++;
+    skipBytes(size);
+}
 
-        case svc_chokecount:
-            parseSvcChokeCount();
+void QWClientPrivate::skipSvcPacketEntities()
+{
+    myPlayerFrameFlag = true;
+    for(;;)
+    {
+        int word = (unsigned short)readShort();
+        if(!word || myBadReadFlag)
             break;
+        skipDelta(word);
+    }
+}
 
-        case svc_modellist:
-            parseSvcModellist();
-            break;
+void QWClientPrivate::skipSvcDeltaPacketEntities()
+{
+    readByte();
+    skipSvcPacketEntities();
+}
 
-        case svc_soundlist:
-            parseSvcSoundlist();
-            break;
+void QWClientPrivate::skipSvcFTESpawnBaseline2()
+{
+    if(!(myFTEProtocolExtensions & FTE_PEXT_SPAWNSTATIC2))
+    {
+        myClient->onError("illegible server message\nsvc_fte_spawnbaseline2 without FTE_PEXT_SPAWNSTATIC2\n");
+        disconnect();
+        return;
+    }
+    skipDelta((unsigned short)readShort());
+}
 
-        case svc_packetentities:
-            parseSvcPacketEntities();
-            break;
+void QWClientPrivate::skipSvcFTESpawnStatic2()
+{
+    if(myFTEProtocolExtensions & FTE_PEXT_SPAWNSTATIC2)
+        skipDelta((unsigned short)readShort());
+}
 
-        case svc_deltapacketentities:
-            parseSvcDeltaPacketEntities();
-            break;
+void QWClientPrivate::skipSvcLightStyle()
+{
+    readByte();
+    skipString();
+}
 
-        case svc_maxspeed:
-            parseSvcMaxSpeed();
-            break;
+void QWClientPrivate::skipSvcString()
+{
+    skipString();
+}
 
-        case svc_entgravity:
-            parseSvcEntGravity();
-            break;
+void QWClientPrivate::skipSvcServerinfo()
+{
+    skipString();
+    skipString();
+}
 
-        case svc_setpause:
-            parseSvcSetPause();
-            break;
+void QWClientPrivate::skipSvcUpdateUserinfo()
+{
+    skipBytes(5);
+    skipString();
+}
 
-        case svc_nails2:
-            parseSvcNails2();
-            break;
+void QWClientPrivate::skipSvcFTEVoiceChat()
+{
+    skipBytes(3);
+    skipBytes((quint16)readShort());
+}
 
-        case svc_fte_modellistshort:
-            parseSvcFTEModellistShort();
-            break;
+const char* QWClientPrivate::messageName(quint8 svc)
+{
+    return ourSvcParsers[0][svc].name;
+}
 
-        case svc_fte_spawnbaseline2:
-            parseSvcFTESpawnBaseline2();
-            break;
+const QWClient::MessageStats& QWClientPrivate::messageStats(quint8 svc) const
+{
+    return myMessageStats[svc];
+}
 
-        case svc_qizmovoice:
-            parseSvcQizmoVoice();
-            break;
+void QWClientPrivate::resetMessageStats()
+{
+    memset(myMessageStats, 0, sizeof(myMessageStats));
+}
 
-        case svc_fte_voicechat:
-            parseSvcFTEVoiceChat();
-            break;
+void QWClientPrivate::setMessageTiming(bool enabled)
+{
+    myMessageTimingFlag = enabled;
+}
 
-        case svc_fte_spawnstatic2:
-            parseSvcFTESpawnStatic2();
-            break;
-        case nq_svc_time:
-            parseSvcTime();
-            break;
-        case nq_svc_clientdata:
-            parseSvcClientData();
-            break;
-        case nq_svc_version:
-            parseSvcVersion();
-            break;
-        case nq_svc_particle:
-            parseSvcParticle();
-            break;
-        case nq_svc_signonnum:
-            parseSvcSignonNum();
-            break;
-        case nq_svc_updatecolors:
-            parseSvcUpdateColors();
-            break;
-        case nq_svc_updatename:
-            parseSvcUpdateName();
-            break;
-        default:
-            myClient->onError(QString("Unknown message from server. Last Cmd: [" + QString::number(last) + "] Current Cmd: [" + QString::number(c) + "]").toLatin1().data());
-            disconnect();
-            return;
-        }
-        last = c;
-    }
+void QWClientPrivate::setAllocationCounter(const quint64 *counter)
+{
+    myAllocationCounter = counter;
 }
 
 void QWClientPrivate::connect(const char *host, quint16 port)
@@ -1906,17 +3140,12 @@ void QWClientPrivate::connect(const char *host, quint16 port)
     myHost.setAddress(host);
     myPort = port;
 
-    myIncomingSeq = 0;
-    myIncomingAck = 0;
-    myOutgoingSeq = 0;
-    myLastRealiableSeq = 0;
-    myIncomingSeqReliableFlag = false;
-    myIncomingAckReliableFlag = false;
-    myOutgoingSeqReliableFlag = false;
-    myPacketLoss = 0;
+    resetNetchan();
 
     mySocket->connectToHost(myHost, myPort);
     mySocket->waitForConnected();
+    myKernelDropCount = 0;
+    setupSocketOptions();
     sendConnectionless("getchallenge\n");
     myClient->onChallenge();
     myQPort = qrand() & 0xffff;
@@ -1925,6 +3154,27 @@ void QWClientPrivate::connect(const char *host, quint16 port)
     myState = QWClient::ConnectingState;
 
     *myLastServerReplyTime = QTime::currentTime();
+    socketChanged();
+}
+
+void QWClientPrivate::resetNetchan()
+{
+    myIncomingSeq = 0;
+    myIncomingAck = 0;
+    myOutgoingSeq = 0;
+    myLastRealiableSeq = 0;
+    myIncomingSeqReliableFlag = false;
+    myIncomingAckReliableFlag = false;
+    myOutgoingSeqReliableFlag = false;
+    myPacketLoss = 0;
+    myFTEProtocolExtensions = 0;
+    myFTEProtocolExtensions2 = 0;
+    selectSvcParsers();
+    resetEntityFrames();
+    resetBaselines();
+    resetPlayers();
+    resetScoreboard();
+    resetStats();
 }
 
 void QWClientPrivate::setBindHost(const QString &host)
@@ -1947,8 +3197,10 @@ void QWClientPrivate::disconnect()
         writeString(&myUnreliableOutStream, "drop");
         sendToServer(true);
     }
+    flushSendQueue();
     mySocket->close();
     myState = QWClient::DisconnectedState;
+    socketChanged();
 }
 
 void QWClientPrivate::sendConnectionless(const QByteArray &data)
@@ -1956,13 +3208,130 @@ void QWClientPrivate::sendConnectionless(const QByteArray &data)
     QByteArray d;
     d.append("\xff\xff\xff\xff");
     d.append(data);
-    mySocket->write(d);
-    mySocket->waitForBytesWritten();
+    sendDatagram(d.constData(), d.size());
+}
+
+void QWClientPrivate::sendDatagram(const char *data, int size)
+{
+    if(!mySocket->isOpen())
+        return;
+
+    /* Let the pool send it together with everything else queued this round */
+    if(myPool && myPool->batchedSend() && size <= MAX_UDP_PACKET)
+    {
+        if(mySendQueueCount == SendQueueSize)
+            flushSendQueue();
+        if(!mySendQueueCount)
+            myPool->queueSend(this);
+        mySendQueue.append(data, size);
+        mySendQueueSizes[mySendQueueCount++] = size;
+        return;
+    }
+
+#ifdef Q_OS_LINUX
+    if(::send(mySocket->socketDescriptor(), data, size, MSG_DONTWAIT) < 0)
+    {
+        if(errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+            mySendBackpressure++;
+        else
+            mySendErrors++;
+    }
+#else
+    if(mySocket->write(data, size) < 0)
+    {
+        if(mySocket->error() == QAbstractSocket::TemporaryError)
+            mySendBackpressure++;
+        else
+            mySendErrors++;
+    }
+#endif
+}
+
+void QWClientPrivate::flushSendQueue()
+{
+    if(!mySendQueueCount)
+        return;
+
+    int count = mySendQueueCount;
+    mySendQueueCount = 0;
+
+    if(!mySocket->isOpen())
+    {
+        mySendQueue.resize(0);
+        return;
+    }
+
+#ifdef Q_OS_LINUX
+    struct mmsghdr	msgs[SendQueueSize];
+    struct iovec		iovs[SendQueueSize];
+    char*						data = mySendQueue.data();
+
+    memset(msgs, 0, sizeof(msgs));
+    for(int i = 0; i < count; ++i)
+    {
+        iovs[i].iov_base = data;
+        iovs[i].iov_len = mySendQueueSizes[i];
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        data += mySendQueueSizes[i];
+    }
+
+    /*
+      sendmmsg stops at the first datagram that fails, sending again reports why.
+      Whatever the kernel won't take now is lost, netchan resends reliable data.
+    */
+    int offset = 0;
+    while(offset < count)
+    {
+        int sent = sendmmsg(mySocket->socketDescriptor(), msgs + offset, count - offset, MSG_DONTWAIT);
+        if(sent < 0)
+        {
+            if(errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+            {
+                mySendBackpressure += count - offset;
+                break;
+            }
+            mySendErrors++;
+            offset++;
+        }
+        else
+        {
+            offset += sent;
+        }
+    }
+#else
+    const char* data = mySendQueue.constData();
+    for(int i = 0; i < count; ++i)
+    {
+        if(mySocket->write(data, mySendQueueSizes[i]) < 0)
+        {
+            if(mySocket->error() == QAbstractSocket::TemporaryError)
+                mySendBackpressure++;
+            else
+                mySendErrors++;
+        }
+        data += mySendQueueSizes[i];
+    }
+#endif
+
+    mySendQueue.resize(0);
 }
 
 void QWClientPrivate::sendMovement()
 {
+    EntityFrame& frame = myEntityFrames[myOutgoingSeq & UPDATE_MASK];
+
     myUnreliableOutStream << (quint8)clc_move << (quint8)0x10 << (quint8)myPacketLoss << (quint8)0x00 << (quint8)0x00 << (quint8)0x00 << (quint8)0x22 << (quint8)0x00 << (quint8)0x21;
+
+    /* Ask for the entities as a delta against the last complete frame we have */
+    frame.deltaSequence = -1;
+    if(!myValidSequence || myOutgoingSeq - myValidSequence >= UPDATE_BACKUP - 1)
+        return;
+    if(!messageInterest(svc_packetentities) || !messageInterest(svc_deltapacketentities))
+        return;
+
+    frame.deltaSequence = myValidSequence;
+    myUnreliableOutStream << (quint8)clc_delta << (quint8)(myValidSequence & 0xff);
 }
 
 //=====================================================================
@@ -24,20 +24,36 @@ along with this program.  If not, see < http://www.gnu.org/licenses/ >.
 #include <QBuffer>
 #include <QDataStream>
 #include <QHostAddress>
+#include <QElapsedTimer>
 #include <QList>
+#include <QLatin1String>
+#include <QMutex>
+#include <QVector>
+#include <QtEndian>
+#include <string.h>
 #include "QWClient.h"
+#include "QWEntityStore.h"
+#include "QWSpatialIndex.h"
+#include "QWPositionHistory.h"
+#include "QWWorldSnapshot.h"
+#include "QWEventQueue.h"
+#include "QWInfo.h"
 #include "quakedef.h"
 
 class QWClient;
+class QWClientPool;
 class QWPack;
 class QWClientPrivate
 {
+	friend class QWClientPool;
 public:
 	QWClientPrivate(QWClient *client);
 	~QWClientPrivate();
 
 	void							connect(const char *host, quint16 port);
 	void							run();
+	void							runUntil(int msecs);
+	int								nextDeadline() const;
   void							disconnect();
 	void							observe();
 	void							join();
@@ -50,6 +66,7 @@ public:
   void              setPassword(const QString& password);
 	void							setPing(quint16 ping);
 	void							setRate(quint16 rate);
+	void							setReceiveBufferSize(int bytes);
 	void							sendCmd(const QString& cmd);
   const QString&    gameDir() const;
   const QString&    quakeDir() const;
@@ -57,8 +74,53 @@ public:
 	const QString			host() const { return myHost.toString(); }
 	quint16						port() const { return myPort; }
 	QWClient::ClientState state() const { return myState; }
+	int								packetsDrained() const { return myPacketsDrained; }
+	int								packetsDropped() const { return myPacketsDropped; }
+	quint32						sendBackpressure() const { return mySendBackpressure; }
+	quint32						sendErrors() const { return mySendErrors; }
 	static void				stripColor(char* string);
 
+	static const char*messageName(quint8 svc);
+	const QWClient::MessageStats& messageStats(quint8 svc) const;
+	void							resetMessageStats();
+	void							setMessageTiming(bool enabled);
+	void							setAllocationCounter(const quint64* counter);
+	void							setMessageInterest(quint8 svc, bool interested);
+	void							replay(const char *data, int size);
+	bool							setCaptureFile(const QString& fileName);
+	int								entityCount() const;
+	QWClient::EntityState entity(int index) const;
+	QWClient::EntityState baseline(int number) const;
+	int								staticEntityCount() const;
+	QWClient::EntityState staticEntity(int index) const;
+	const QWClient::PlayerState& playerState(int playerNum) const;
+	const QWSpatialIndex& spatialIndex() const;
+	void							setPositionHistory(int snapshots);
+	const QWClient::ScoreboardEntry& scoreboard(int playerNum) const;
+	quint32						scoreboardChanges() const;
+	void							clearScoreboardChanges();
+	QString						serverInfo(const QString& key) const;
+	const QWInfo&			serverInfo() const;
+	const QWInfo&			userInfo(int playerNum) const;
+	const int*				stats() const;
+	quint32						statChanges() const;
+	void							clearStatChanges();
+	void							setSnapshotPublishing(bool enabled);
+	QWWorldSnapshot		snapshot() const;
+	int								projectileCount() const;
+	int								tempEntityCount() const;
+	void							setEventBatching(bool enabled);
+	bool							eventBatching() const;
+	void							setEventQueue(QWEventQueue* queue);
+	const QWClient::TempEntity* tempEntities() const;
+	const QWClient::Projectile* projectiles() const;
+	qint64						clock() const;
+	bool							playerPositionAt(int playerNum, qint64 time, float* origin) const;
+	bool							entityPositionAt(int number, qint64 time, float* origin) const;
+	const QWEntityStore& entityStore() const;
+	bool							messageInterest(quint8 svc) const;
+	static bool				messageSkippable(quint8 svc);
+
 private:
 	class QWClient*		myClient;
 	class QUdpSocket* mySocket;
@@ -69,10 +131,28 @@ private:
 	QHostAddress			myHost;
 	quint16						myPort;
 
-	/* Incoming data buffers */
-	QByteArray				myInData;
-	QBuffer						myInBuffer;
-	QDataStream				myInStream;
+	/* Incoming datagram being parsed, points straight into the receive ring */
+	quint8*						myInBegin;
+	quint8*						myInCursor;
+	quint8*						myInEnd;					//always points to a NUL sentinel
+
+	/* Received datagrams are recorded here when capturing */
+	class QFile*			myCaptureFile;
+	bool							myReplayFlag;			//nothing was sent, delta frames trust the base the server names
+
+	/* Batched receive, every pending datagram is drained on each run() */
+	enum { RecvBatchSize = 16, RecvSlotSize = MAX_UDP_PACKET + 1 };
+	QByteArray				myRecvRing;				//RecvBatchSize slots, each datagram gets a NUL appended
+	int								myPacketsDrained;
+	int								myPacketsDropped;
+	quint32						myKernelDropCount;	//last SO_RXQ_OVFL counter seen
+	int								myReceiveBufferSize;
+
+	/* Pool this client is driven by, if any */
+	QWClientPool*			myPool;
+	int								myPoolFd;					//descriptor registered with the pool
+	qint64						myPoolDeadline;		//pool clock msecs, -1 when not scheduled
+	quint32						myPoolIteration;
 
 	/* Outgoing client data buffers */
 	QDataStream				myUnreliableOutStream;
@@ -89,6 +169,15 @@ private:
 	QBuffer						myOutBuffer;
 	QByteArray				myOutData;
 
+	/* Non blocking egress, datagrams are queued here when the pool batches sends */
+	enum { SendQueueSize = 8 };
+	QByteArray				mySendQueue;
+	int								mySendQueueSizes[SendQueueSize];
+	int								mySendQueueCount;
+	bool							mySendPending;					//listed in the pool's pending sends
+	quint32						mySendBackpressure;
+	quint32						mySendErrors;
+
 	bool							myBadReadFlag;
 
 	static const char*ClientName;
@@ -100,6 +189,7 @@ private:
 	quint16						myQPort;
 	quint32						myProtocolVersion;
 	quint32						myFTEProtocolExtensions;
+	quint32						myFTEProtocolExtensions2;
 	quint32						myServerCount;
   QString						myGameDir;
 	QString						myQuakeDir;
@@ -116,6 +206,78 @@ private:
 	quint8						myPacketLoss;
 	quint16						myPing;
 
+	/* Packet entities, one frame per outgoing sequence */
+	struct EntityFrame
+	{
+		packetEntities_t	packetEntities;
+		int								deltaSequence;	//frame the server was asked to delta from, -1 for none
+		bool							invalid;
+	};
+	EntityFrame				myEntityFrames[UPDATE_BACKUP];
+	quint32						myValidSequence;				//last frame holding a complete entity set, 0 for none
+	void							resetEntityFrames();
+	void							flushEntityPacket();
+	const packetEntities_t* currentEntities() const;
+	QWEntityStore			myEntityStore;					//last complete frame as separate arrays
+	void							fillEntityStore(const packetEntities_t* entities);
+	QWSpatialIndex		mySpatialIndex;					//players and the last complete frame
+	QWPositionHistory	myPositionHistory;			//players first, entities after MAX_CLIENTS
+
+	/* Players, updated in place by svc_playerinfo */
+	QWClient::PlayerState	myPlayers[MAX_CLIENTS];
+	int								myPlayerModelIndex;
+	quint32						myIndexedPlayers;				//slots in mySpatialIndex
+	quint32						mySeenPlayers;					//slots with a playerinfo in the current datagram
+	bool							myPlayerFrameFlag;			//the current datagram carried a frame
+	void							resetPlayers();
+	void							removeUnseenPlayers();
+
+	/* Nails of the current server message */
+	enum { MaxProjectiles = 256 };
+	QWClient::Projectile myProjectiles[MaxProjectiles];
+	int								myProjectileCount;
+	void							parseNails(int recordSize);
+	static void				unpackNails(const quint8* records, int recordSize, int count, QWClient::Projectile* out);
+
+	/* Temp entities of the current server message */
+	enum { MaxTempEntities = 128 };
+	QWClient::TempEntity myTempEntities[MaxTempEntities];
+	int								myTempEntityCount;
+
+	/* Gameplay callbacks recorded for one onEvents() per datagram */
+	bool							myBatchEventsFlag;
+	QVector<QWClient::Event> myEvents;					//reused, only its size is reset
+	QWClient::Event*	appendEvent(QWClient::EventType type, int playerNum = 0);
+	QWEventQueue*			myEventQueue;						//takes the events instead of onEvents() when set
+
+	/* Scoreboard and serverinfo */
+	QWClient::ScoreboardEntry myScoreboard[MAX_CLIENTS];
+	quint32						myScoreboardChanges;		//bit per slot, cleared by the user
+	QWInfo						myUserInfo[MAX_CLIENTS];
+	QWInfo						myServerInfo;
+	void							resetScoreboard();
+	void							updateScoreboardInfo(int playerNum);			//copies the userinfo fields of the scoreboard line
+
+	/* Stats of the tracked player */
+	int								myStats[MAX_CL_STATS];
+	quint32						myStatChanges;					//bit per stat, cleared by the user
+	void							resetStats();
+	void							setStat(int index, int value);
+
+	/* Snapshots for readers on other threads, pooled so publishing doesn't allocate */
+	bool							myPublishSnapshotsFlag;
+	QList<QWWorldSnapshot> mySnapshotPool;
+	QWWorldSnapshot		myCurrentSnapshot;
+	mutable QMutex		mySnapshotMutex;				//guards myCurrentSnapshot only
+	void							publishSnapshot();
+
+	/* Entities new to a frame are delta'd from their baseline */
+	entityState_t			myBaselines[MAX_EDICTS];
+	QList<entityState_t> myStaticEntities;
+	void							resetBaselines();
+	int								peekEntityNumber(int bits) const;
+	void							readBaseline(entityState_t *es);
+
 	/* Download */
 	QList<QWPack*>		myPacks;
 
@@ -135,10 +297,19 @@ private:
 	void							reloadPackFiles();
 	void							loadPackFile(const QString& filename);
 
+	int								msecsToNextSend() const;
+	void							socketChanged();
+
+	void							sendDatagram(const char *data, int size);
+	void							flushSendQueue();
 	void							sendConnectionless(const QByteArray& data);
 	void							sendMovement(); //required on MVDSV
   void							sendToServer(bool dontWait = false);
 	void							readPackets();
+	void							readPacketsBatched();
+	void							resetNetchan();
+	void							processDatagram(char *data, int size);
+	void							setupSocketOptions();
 
 	void							startDownload(const QString& filename);
 
@@ -151,10 +322,44 @@ private:
 	quint32						mapChecksum(const QString& mapName);
     quint32 _mapChecksum;       // checksum we got from error message
     bool myWrongChecksumFlag;   // for faster reconection
+
+	/* Per svc dispatch table, shared by all clients */
+	typedef void (QWClientPrivate::*ParseFunction)();
+	struct SvcParser
+	{
+		SvcParser(): parse(NULL), skip(NULL), name(NULL), skippable(false), size(0) {}
+		SvcParser(ParseFunction p, const char* n): parse(p), skip(NULL), name(n), skippable(false), size(0) {}
+		ParseFunction		parse;
+		ParseFunction		skip;				//advances over the message without decoding it
+		const char*			name;
+		bool						skippable;	//when skip is NULL the message has a fixed size
+		quint8					size;
+	};
+	/* One table for legacy coords and one for float coords, hot parsers are specialized for each */
+	static SvcParser	ourSvcParsers[2][256];
+	static bool				ourSvcParsersFilled;
+	static bool				fillSvcParsers();
+	static void				setSvcParser(quint8 svc, ParseFunction parse, const char* name);
+	static void				setSvcParser(quint8 svc, ParseFunction parse, ParseFunction parseFloatCoords, const char* name);
+	static void				setSvcSkip(quint8 svc, ParseFunction skip);
+	static void				setSvcLayout(quint8 svc, quint8 bytes, quint8 coords, quint8 angles);
+
+	const SvcParser*	mySvcParsers;				//table for the negotiated extensions
+	void							selectSvcParsers();
+
+	/* Messages nobody is interested in, one bit per svc */
+	quint32						myIgnoredMessages[8];
+
+	/* Parse statistics */
+	QWClient::MessageStats myMessageStats[256];
+	bool							myMessageTimingFlag;
+	const quint64*		myAllocationCounter;		//owned by the caller
+	QElapsedTimer			myClock;								//parse timing and position history timestamps
         
 	//========================================================================
 	// Parsing functions
 	/* Main parsing functions */
+	bool							acceptMessage();		//netchan header, false for stale and duplicate datagrams
 	void							parseServerMessage();
 	void							parseConnectionless();
 
@@ -164,17 +369,29 @@ private:
 	static quint32		littleLong(quint32 l);
 
 	/* Reading */
-	bool							checkForBadRead(quint8 typeSize);
+	inline bool				checkForBadRead(int size);
+	inline void				skipBytes(int count);
 	float							readCoord();
 	float							readAngle();
+	template<bool FloatCoords> float readCoord();
+	template<bool FloatCoords> float readAngle();
 	float							readAngle16();
-	quint8						readByte();
-	float							readFloat();
-	qint16						readShort();
-	qint32						readLong();
+	inline quint8			readByte();
+	inline float			readFloat();
+	inline qint16			readShort();
+	inline qint32			readLong();
 	const QString			readString();
+	QLatin1String			readStringView();
 	void							readUserDeltaCmd(userCmd_t *from, userCmd_t *move);
 	void							parseDelta(entityState_t *from, entityState_t *to, int bits);
+	template<bool FloatCoords> void parseDelta(entityState_t *from, entityState_t *to, int bits);
+
+	/* Skipping */
+	int								coordSize() const { return myFTEProtocolExtensions & FTE_PEXT_FLOATCOORDS ? 4 : 2; }
+	int								angleSize() const { return myFTEProtocolExtensions & FTE_PEXT_FLOATCOORDS ? 2 : 1; }
+	void							skipString();
+	void							skipUserDeltaCmd();
+	void							skipDelta(int bits);
 
 	/* Writing */
 	static void				writeByte(QDataStream* stream, const quint8 b);
@@ -195,7 +412,7 @@ private:
   void							parseSvcServerData();//s
   void							parseSvcSetAngle();//
   void							parseSvcLightStyle();//
-  void							parseSvcSound();//
+  template<bool FloatCoords> void parseSvcSound();//
   void							parseSvcStopSound();//
   void							parseSvcUpdateFrags();//
   void							parseSvcUpdatePing();//
@@ -203,7 +420,7 @@ private:
   void							parseSvcUpdateEnterTime();//
   void							parseSvcSpawnBaseLine();//
   void							parseSvcSpawnStatic();//
-  void							parseSvcTempEntity();//
+  template<bool FloatCoords> void parseSvcTempEntity();//
   void							parseSvcKilledMonster();//
   void							parseSvcFoundSecret();//
   void							parseSvcUpdateStat();//
@@ -221,12 +438,13 @@ private:
   void							parseSvcServerinfo();//
   void							parseSvcDownload();//
   void							parseChunkedDownload();//NA
-  void							parseSvcPlayerinfo();//
+  template<bool FloatCoords> void parseSvcPlayerinfo();//
   void							parseSvcNails();//fixed
   void							parseSvcChokeCount();//
   void							parseSvcSoundlist();//
-  void							parseSvcPacketEntities();//look at it
-  void							parseSvcDeltaPacketEntities();//look at it
+  template<bool FloatCoords> void parseSvcPacketEntities();//look at it
+  template<bool FloatCoords> void parseSvcDeltaPacketEntities();//look at it
+	template<bool FloatCoords> void parsePacketEntities(bool delta);
   void							parseSvcMaxSpeed();//
   void							parseSvcEntGravity();//
   void							parseSvcSetPause();//
@@ -242,6 +460,87 @@ private:
   void              parseSvcVersion();
   void              parseSvcClientData();
   void              parseSvcTime();
+
+	/* Command skippers, used for messages nobody is interested in */
+	void							skipSvcSound();
+	void							skipSvcTempEntity();
+	void							skipSvcNails();
+	void							skipSvcNails2();
+	void							skipSvcPlayerinfo();
+	void							skipSvcPacketEntities();
+	void							skipSvcDeltaPacketEntities();
+	void							skipSvcFTESpawnBaseline2();
+	void							skipSvcFTESpawnStatic2();
+	void							skipSvcLightStyle();
+	void							skipSvcString();
+	void							skipSvcServerinfo();
+	void							skipSvcUpdateUserinfo();
+	void							skipSvcFTEVoiceChat();
 };
 
+//========================================================================
+// Inline readers, the parser spends most of its time in these
+
+bool QWClientPrivate::checkForBadRead(int size)
+{
+	if(myInEnd - myInCursor < size)
+	{
+		myBadReadFlag = true;
+		return true;
+	}
+	return false;
+}
+
+void QWClientPrivate::skipBytes(int count)
+{
+	if(myInEnd - myInCursor < count)
+	{
+		myBadReadFlag = true;
+		myInCursor = myInEnd;
+		return;
+	}
+	myInCursor += count;
+}
+
+quint8 QWClientPrivate::readByte()
+{
+	if(checkForBadRead(1))
+		return 0xff;
+
+	return *myInCursor++;
+}
+
+qint16 QWClientPrivate::readShort()
+{
+	if(checkForBadRead(2))
+		return -1;
+
+	qint16 s = qFromLittleEndian<qint16>(myInCursor);
+	myInCursor += 2;
+	return s;
+}
+
+qint32 QWClientPrivate::readLong()
+{
+	if(checkForBadRead(4))
+		return -1;
+
+	qint32 l = qFromLittleEndian<qint32>(myInCursor);
+	myInCursor += 4;
+	return l;
+}
+
+float QWClientPrivate::readFloat()
+{
+	if(checkForBadRead(4))
+		return -1;
+
+	quint32 l = qFromLittleEndian<quint32>(myInCursor);
+	myInCursor += 4;
+
+	float f;
+	memcpy(&f, &l, sizeof(f));
+	return f;
+}
+
 #endif // QWCLIENTPRIVATE_H
@@ -0,0 +1,127 @@
+/*
+GNU General Public License version 3 notice
+
+Copyright (C) 2012 Mihawk <luiz@netdome.biz>. All rights reserved.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see < http://www.gnu.org/licenses/ >.
+*/
+
+#include "QWEntityStore.h"
+#include <string.h>
+
+QWEntityStore::QWEntityStore():
+	myCount(0)
+{
+}
+
+QWClient::EntityState QWEntityStore::entity(int index) const
+{
+	QWClient::EntityState state;
+
+	if(index < 0 || index >= myCount)
+	{
+		memset(&state, 0, sizeof(state));
+		return state;
+	}
+
+	state.number = myNumbers[index];
+	state.origin[0] = myOriginX[index];
+	state.origin[1] = myOriginY[index];
+	state.origin[2] = myOriginZ[index];
+	state.angles[0] = myPitch[index];
+	state.angles[1] = myYaw[index];
+	state.angles[2] = myRoll[index];
+	state.modelIndex = myModelIndices[index];
+	state.frame = myFrames[index];
+	state.colorMap = myColorMaps[index];
+	state.skinNum = mySkinNums[index];
+	state.effects = myEffects[index];
+	return state;
+}
+
+bool QWEntityStore::append(const QWClient::EntityState& state)
+{
+	if(myCount >= Capacity)
+		return false;
+
+	int i = myCount++;
+	myNumbers[i] = state.number;
+	myOriginX[i] = state.origin[0];
+	myOriginY[i] = state.origin[1];
+	myOriginZ[i] = state.origin[2];
+	myPitch[i] = state.angles[0];
+	myYaw[i] = state.angles[1];
+	myRoll[i] = state.angles[2];
+	myModelIndices[i] = state.modelIndex;
+	myFrames[i] = state.frame;
+	myColorMaps[i] = state.colorMap;
+	mySkinNums[i] = state.skinNum;
+	myEffects[i] = state.effects;
+	myFlags[i] = 0;
+	return true;
+}
+
+void QWEntityStore::clear()
+{
+	myCount = 0;
+}
+
+int QWEntityStore::indexOf(int number) const
+{
+	/* Entities are sorted by number */
+	int low = 0;
+	int high = myCount - 1;
+
+	while(low <= high)
+	{
+		int middle = (low + high) / 2;
+		if(myNumbers[middle] < number)
+			low = middle + 1;
+		else if(myNumbers[middle] > number)
+			high = middle - 1;
+		else
+			return middle;
+	}
+	return -1;
+}
+
+int QWEntityStore::withinRadius(float x, float y, float z, float radius, int* indices, int maxIndices) const
+{
+	bool inside[Capacity];
+	float radius2 = radius * radius;
+	int found = 0;
+
+	for(int i = 0; i < myCount; ++i)
+	{
+		float dx = myOriginX[i] - x;
+		float dy = myOriginY[i] - y;
+		float dz = myOriginZ[i] - z;
+		inside[i] = dx * dx + dy * dy + dz * dz <= radius2;
+	}
+
+	for(int i = 0; i < myCount && found < maxIndices; ++i)
+		if(inside[i])
+			indices[found++] = i;
+	return found;
+}
+
+int QWEntityStore::withModel(int modelIndex, int* indices, int maxIndices) const
+{
+	int found = 0;
+
+	for(int i = 0; i < myCount && found < maxIndices; ++i)
+		if(myModelIndices[i] == modelIndex)
+			indices[found++] = i;
+	return found;
+}
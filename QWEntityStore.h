@@ -0,0 +1,131 @@
+/*
+GNU General Public License version 3 notice
+
+Copyright (C) 2012 Mihawk <luiz@netdome.biz>. All rights reserved.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see < http://www.gnu.org/licenses/ >.
+*/
+
+#ifndef QWENTITYSTORE_H
+#define QWENTITYSTORE_H
+
+#include "qwclient_global.h"
+#include "QWClient.h"
+
+/**
+  The entities of one packet entities frame stored as separate arrays.
+
+  Every field has its own contiguous array so that scans over a single
+  field (positions, model indices) touch only the memory they need and
+  can be vectorized by the compiler. Index i in every array describes the
+  same entity, entities are sorted by entity number.
+*/
+class QWCLIENTSHARED_EXPORT QWEntityStore
+{
+	friend class QWClientPrivate;
+public:
+	enum { Capacity = 64 };	//MAX_PACKET_ENTITIES
+
+	QWEntityStore();
+
+	int						count() const { return myCount; }
+	const int*		numbers() const { return myNumbers; }
+	const float*	originX() const { return myOriginX; }
+	const float*	originY() const { return myOriginY; }
+	const float*	originZ() const { return myOriginZ; }
+	const float*	pitch() const { return myPitch; }
+	const float*	yaw() const { return myYaw; }
+	const float*	roll() const { return myRoll; }
+	const int*		modelIndices() const { return myModelIndices; }
+	const int*		frames() const { return myFrames; }
+	const int*		colorMaps() const { return myColorMaps; }
+	const int*		skinNums() const { return mySkinNums; }
+	const int*		effects() const { return myEffects; }
+	const int*		flags() const { return myFlags; }	//U_* bits of the last delta
+
+	QWClient::EntityState entity(int index) const;
+
+	/**
+		Appends an entity, entities must be appended in entity number order.
+
+		@return	False when the store is full
+	*/
+	bool					append(const QWClient::EntityState& state);
+	void					clear();
+
+	/**
+		Finds an entity by its entity number.
+
+		@return	The index into the arrays or -1
+	*/
+	int						indexOf(int number) const;
+
+	/**
+		Collects the entities inside a sphere.
+
+		@param	indices Receives the indices into the arrays
+		@param	maxIndices Size of indices
+		@return	The number of indices written
+	*/
+	int						withinRadius(float x, float y, float z, float radius, int* indices, int maxIndices) const;
+
+	/**
+		Collects the entities using a model.
+
+		@return	The number of indices written
+	*/
+	int						withModel(int modelIndex, int* indices, int maxIndices) const;
+
+	/**
+		Calls function(index) for every entity inside the sphere, optionally
+		restricted to one model index (-1 for any).
+	*/
+	template<typename Function>
+	void					forEachWithinRadius(float x, float y, float z, float radius, int modelIndex, Function function) const
+	{
+		bool inside[Capacity];
+		float radius2 = radius * radius;
+
+		/* Distance pass without branches so the compiler can vectorize it */
+		for(int i = 0; i < myCount; ++i)
+		{
+			float dx = myOriginX[i] - x;
+			float dy = myOriginY[i] - y;
+			float dz = myOriginZ[i] - z;
+			inside[i] = (dx * dx + dy * dy + dz * dz <= radius2) & (modelIndex < 0 || myModelIndices[i] == modelIndex);
+		}
+
+		for(int i = 0; i < myCount; ++i)
+			if(inside[i])
+				function(i);
+	}
+
+private:
+	int						myCount;
+	int						myNumbers[Capacity];
+	float					myOriginX[Capacity];
+	float					myOriginY[Capacity];
+	float					myOriginZ[Capacity];
+	float					myPitch[Capacity];
+	float					myYaw[Capacity];
+	float					myRoll[Capacity];
+	int						myModelIndices[Capacity];
+	int						myFrames[Capacity];
+	int						myColorMaps[Capacity];
+	int						mySkinNums[Capacity];
+	int						myEffects[Capacity];
+	int						myFlags[Capacity];
+};
+
+#endif // QWENTITYSTORE_H
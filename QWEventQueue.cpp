@@ -0,0 +1,185 @@
+/*
+GNU General Public License version 3 notice
+
+Copyright (C) 2012 Mihawk <luiz@netdome.biz>. All rights reserved.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see < http://www.gnu.org/licenses/ >.
+*/
+
+#include "QWEventQueue.h"
+#include <QThread>
+#include <string.h>
+
+QWEventQueue::QWEventQueue(int capacity, OverflowPolicy policy):
+	myPolicy(policy),
+	myHead(0),
+	myTail(0),
+	myDropped(0),
+	myBlocked(0)
+{
+	int size = 2;
+	while(size < capacity)
+		size <<= 1;
+	mySlots.resize(size);
+	myMask = size - 1;
+	for(int i = 0; i < size; ++i)
+		mySlots[i].sequence.storeRelease(i);
+}
+
+int QWEventQueue::capacity() const
+{
+	return mySlots.size();
+}
+
+QWEventQueue::OverflowPolicy QWEventQueue::overflowPolicy() const
+{
+	return myPolicy;
+}
+
+void QWEventQueue::setOverflowPolicy(OverflowPolicy policy)
+{
+	myPolicy = policy;
+}
+
+void QWEventQueue::copyText(Record* record, const char* text, const char* text2)
+{
+	char* out = record->text;
+	char* end = record->text + TextSize;
+
+	record->event.text = NULL;
+	record->event.text2 = NULL;
+
+	if(text)
+	{
+		int length = qMin<int>(strlen(text), TextSize - 2);
+		memcpy(out, text, length);
+		out[length] = '\0';
+		record->event.text = out;
+		out += length + 1;
+	}
+
+	if(text2)
+	{
+		int length = qMin<int>(strlen(text2), end - out - 1);
+		memcpy(out, text2, length);
+		out[length] = '\0';
+		record->event.text2 = out;
+	}
+}
+
+bool QWEventQueue::push(const QWClient::Event& event)
+{
+	quint32 head = myHead.loadAcquire();
+	Slot& slot = mySlots[head & myMask];
+	bool waited = false;
+
+	/* The record is free once the consumer, or a drop below, released it for this position */
+	while(slot.sequence.loadAcquire() != head)
+	{
+		/* The consumer already took the oldest record and is copying it, room is coming */
+		quint32 tail = myTail.loadAcquire();
+		if(head - tail <= myMask)
+		{
+			QThread::yieldCurrentThread();
+			continue;
+		}
+
+		if(myPolicy == DropNewest)
+		{
+			myDropped.fetchAndAddRelaxed(1);
+			return false;
+		}
+
+		if(myPolicy == DropOldest)
+		{
+			/* Claim the oldest record like the consumer would and release it unread, fails if the consumer got it first */
+			if(myTail.testAndSetOrdered(tail, tail + 1))
+			{
+				myDropped.fetchAndAddRelaxed(1);
+				slot.sequence.storeRelease(head);
+			}
+			continue;
+		}
+
+		if(!waited)
+		{
+			myBlocked.fetchAndAddRelaxed(1);
+			waited = true;
+		}
+		QThread::yieldCurrentThread();
+	}
+
+	Record* record = &slot.record;
+	record->event = event;
+	copyText(record, event.text, event.text2);
+	slot.sequence.storeRelease(head + 1);
+	myHead.storeRelease(head + 1);
+	return true;
+}
+
+bool QWEventQueue::pop(Record* record)
+{
+	for(;;)
+	{
+		quint32 tail = myTail.loadAcquire();
+		Slot& slot = mySlots[tail & myMask];
+		qint32 ready = qint32(slot.sequence.loadAcquire() - (tail + 1));
+
+		/* Not written yet, the queue is empty */
+		if(ready < 0)
+			return false;
+
+		/* The producer dropped it meanwhile, or the claim races with a drop, retry from the new tail */
+		if(ready > 0 || !myTail.testAndSetOrdered(tail, tail + 1))
+			continue;
+
+		/* The record is ours until its sequence is released, the producer waits for it */
+		const Record& source = slot.record;
+		memcpy(record, &source, sizeof(Record));
+		slot.sequence.storeRelease(tail + myMask + 1);
+
+		/* Point the strings at the copy, only the address of the source is used */
+		if(record->event.text)
+			record->event.text = record->text + (record->event.text - source.text);
+		if(record->event.text2)
+			record->event.text2 = record->text + (record->event.text2 - source.text);
+		return true;
+	}
+}
+
+bool QWEventQueue::isEmpty() const
+{
+	return myTail.loadAcquire() == myHead.loadAcquire();
+}
+
+int QWEventQueue::size() const
+{
+	return myHead.loadAcquire() - myTail.loadAcquire();
+}
+
+quint32 QWEventQueue::dropped() const
+{
+	return myDropped.loadAcquire();
+}
+
+quint32 QWEventQueue::blocked() const
+{
+	return myBlocked.loadAcquire();
+}
+
+void QWEventQueue::resetCounters()
+{
+	myDropped.storeRelease(0);
+	myBlocked.storeRelease(0);
+}
@@ -0,0 +1,102 @@
+/*
+GNU General Public License version 3 notice
+
+Copyright (C) 2012 Mihawk <luiz@netdome.biz>. All rights reserved.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see < http://www.gnu.org/licenses/ >.
+*/
+
+#ifndef QWEVENTQUEUE_H
+#define QWEVENTQUEUE_H
+
+#include "qwclient_global.h"
+#include "QWClient.h"
+#include <QAtomicInteger>
+#include <QVector>
+
+/**
+  Bounded single producer, single consumer queue of client events.
+
+  The client pushes the events of every datagram from the thread calling
+  run() and one worker thread pops them, so slow event handling never
+  delays the network. Records are allocated once with the queue and the
+  strings of an event are copied into its record. Neither side takes a
+  lock.
+
+  Every record carries a sequence number telling whose turn it is, the
+  producer only writes a record after the consumer released it, so a
+  record is never written while it is being copied out, DropOldest
+  included.
+*/
+class QWCLIENTSHARED_EXPORT QWEventQueue
+{
+public:
+	enum OverflowPolicy
+	{
+		DropNewest,	//events that don't fit are discarded
+		DropOldest,	//the oldest queued event makes room
+		Block				//the client waits for the worker, stalling run()
+	};
+
+	enum { TextSize = 256 };	//for text and text2 together, longer strings are truncated
+
+	struct Record
+	{
+		QWClient::Event	event;	//text pointers refer to this record's buffer
+		char						text[TextSize];
+	};
+
+	/**
+		@param	capacity Records kept, rounded up to a power of two
+		@param	policy What push() does when the queue is full
+	*/
+	QWEventQueue(int capacity = 1024, OverflowPolicy policy = DropNewest);
+
+	int							capacity() const;
+	OverflowPolicy	overflowPolicy() const;
+	void						setOverflowPolicy(OverflowPolicy policy);
+
+	/* Producer side */
+	bool						push(const QWClient::Event& event);
+
+	/* Consumer side, false when the queue is empty */
+	bool						pop(Record* record);
+	bool						isEmpty() const;
+	int							size() const; //approximate while the other side is busy
+
+	/* Overflow counters */
+	quint32					dropped() const; //events lost under DropNewest and DropOldest
+	quint32					blocked() const; //pushes that had to wait under Block
+	void						resetCounters();
+
+private:
+	struct Slot
+	{
+		QAtomicInteger<quint32>	sequence;	//position it can be written at, plus one once written
+		Record									record;
+	};
+
+	QVector<Slot>								mySlots;
+	quint32											myMask;
+	OverflowPolicy							myPolicy;
+
+	QAtomicInteger<quint32>			myHead;		//next record written, owned by the producer
+	QAtomicInteger<quint32>			myTail;		//next record read, the producer only advances it under DropOldest
+	QAtomicInteger<quint32>			myDropped;
+	QAtomicInteger<quint32>			myBlocked;
+
+	static void copyText(Record* record, const char* text, const char* text2);
+};
+
+#endif // QWEVENTQUEUE_H
@@ -0,0 +1,352 @@
+/*
+GNU General Public License version 3 notice
+
+Copyright (C) 2012 Mihawk <luiz@netdome.biz>. All rights reserved.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see < http://www.gnu.org/licenses/ >.
+*/
+
+#include "QWInfo.h"
+#include <QAtomicInt>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QVarLengthArray>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* const ourCommonKeyNames[QWInfo::CommonKeyCount] =
+{
+	"name",
+	"team",
+	"topcolor",
+	"bottomcolor",
+	"*spectator",
+	"skin",
+	"hostname",
+	"map"
+};
+
+/*
+	Process wide key table, keys are never removed so names stay valid.
+	Names are written before the bucket pointing at them is published, so
+	lookups read it without the mutex, which only serializes interning.
+*/
+struct QWInfoKeyTable
+{
+	enum { BucketCount = QWInfo::MaxKeys * 2, BucketMask = BucketCount - 1 };
+
+	QMutex			mutex;
+	QAtomicInt	count;
+	QAtomicInt	buckets[BucketCount];	//id + 1, 0 when free
+	char				names[QWInfo::MaxKeys][QWInfo::MaxKeyLength + 1];
+
+	QWInfoKeyTable()
+	{
+		for(int i = 0; i < QWInfo::CommonKeyCount; ++i)
+			insert(ourCommonKeyNames[i], hash(ourCommonKeyNames[i]));
+	}
+
+	static quint32 hash(const char* name)
+	{
+		quint32 h = 2166136261u;
+		while(*name)
+			h = (h ^ (unsigned char)*name++) * 16777619u;
+		return h;
+	}
+
+	int find(const char* name, quint32 h) const
+	{
+		for(;; ++h)
+		{
+			int id = buckets[h & BucketMask].loadAcquire() - 1;
+			if(id == QWInfo::NoKey || !strcmp(names[id], name))
+				return id;
+		}
+	}
+
+	/* Caller holds the mutex and checked the key is missing, never fills the buckets past half */
+	int insert(const char* name, quint32 h)
+	{
+		int id = count.loadAcquire();
+		if(id == QWInfo::MaxKeys)
+			return QWInfo::NoKey;
+
+		strcpy(names[id], name);
+		while(buckets[h & BucketMask].loadAcquire())
+			++h;
+		buckets[h & BucketMask].storeRelease(id + 1);
+		count.storeRelease(id + 1);
+		return id;
+	}
+};
+
+static QWInfoKeyTable& keyTable()
+{
+	static QWInfoKeyTable table;
+	return table;
+}
+
+static int commonKey(const char* name)
+{
+	for(int i = 0; i < QWInfo::CommonKeyCount; ++i)
+		if(!strcmp(name, ourCommonKeyNames[i]))
+			return i;
+	return -1;
+}
+
+QWInfo::QWInfo()
+{
+	for(int i = 0; i < CommonKeyCount; ++i)
+		myCommon[i] = -1;
+}
+
+int QWInfo::key(const char* name)
+{
+	int id = commonKey(name);
+	if(id != -1)
+		return id;
+
+	if(strlen(name) > MaxKeyLength)
+		return NoKey;
+
+	QWInfoKeyTable& table = keyTable();
+	quint32 h = QWInfoKeyTable::hash(name);
+	id = table.find(name, h);
+	if(id != NoKey || table.count.loadAcquire() == MaxKeys)
+		return id;
+
+	QMutexLocker locker(&table.mutex);
+	id = table.find(name, h);
+	if(id == NoKey)
+		id = table.insert(name, h);
+	return id;
+}
+
+int QWInfo::findKey(const char* name)
+{
+	int id = commonKey(name);
+	if(id != -1)
+		return id;
+
+	if(strlen(name) > MaxKeyLength)
+		return NoKey;
+	return keyTable().find(name, QWInfoKeyTable::hash(name));
+}
+
+const char* QWInfo::keyName(int key)
+{
+	if(key >= 0 && key < CommonKeyCount)
+		return ourCommonKeyNames[key];
+
+	QWInfoKeyTable& table = keyTable();
+	if(key < 0 || key >= table.count.loadAcquire())
+		return "";
+	return table.names[key];
+}
+
+int QWInfo::indexOf(int key) const
+{
+	if(key < 0)
+		return -1;
+	if(key < CommonKeyCount)
+		return myCommon[key];
+
+	for(int i = 0; i < myEntries.size(); ++i)
+		if(myEntries.at(i).key == key)
+			return i;
+	return -1;
+}
+
+int QWInfo::indexOf(const char* name) const
+{
+	int key = findKey(name);
+	if(key != NoKey)
+		return indexOf(key);
+
+	/* Keys the table couldn't take */
+	for(int i = 0; i < myEntries.size(); ++i)
+		if(myEntries.at(i).key == NoKey && myEntries.at(i).name == name)
+			return i;
+	return -1;
+}
+
+const char* QWInfo::value(int key) const
+{
+	int i = indexOf(key);
+	return i == -1 ? "" : myEntries.at(i).value;
+}
+
+const char* QWInfo::value(const char* key) const
+{
+	int i = indexOf(key);
+	return i == -1 ? "" : myEntries.at(i).value;
+}
+
+int QWInfo::intValue(int key, int defaultValue) const
+{
+	int i = indexOf(key);
+	return i == -1 ? defaultValue : atoi(myEntries.at(i).value);
+}
+
+bool QWInfo::contains(int key) const
+{
+	return indexOf(key) != -1;
+}
+
+int QWInfo::count() const
+{
+	return myEntries.size();
+}
+
+int QWInfo::keyAt(int index) const
+{
+	return myEntries.at(index).key;
+}
+
+const char* QWInfo::keyNameAt(int index) const
+{
+	const Entry& entry = myEntries.at(index);
+	return entry.key == NoKey ? entry.name.constData() : keyName(entry.key);
+}
+
+const char* QWInfo::valueAt(int index) const
+{
+	return myEntries.at(index).value;
+}
+
+void QWInfo::removeAt(int index)
+{
+	int last = myEntries.size() - 1;
+
+	if(myEntries.at(index).key >= 0 && myEntries.at(index).key < CommonKeyCount)
+		myCommon[myEntries.at(index).key] = -1;
+	if(index != last)
+	{
+		myEntries[index] = myEntries.at(last);
+		if(myEntries.at(index).key >= 0 && myEntries.at(index).key < CommonKeyCount)
+			myCommon[myEntries.at(index).key] = index;
+	}
+	myEntries.resize(last);
+}
+
+bool QWInfo::update(int index, int key, const char* name, const char* value)
+{
+	if(!*value)
+	{
+		if(index == -1)
+			return false;
+		removeAt(index);
+		return true;
+	}
+
+	if(index == -1)
+	{
+		index = myEntries.size();
+		myEntries.resize(index + 1);
+		myEntries[index].key = key;
+		if(key == NoKey)
+			myEntries[index].name = QByteArray(name);
+		myEntries[index].value[0] = '\0';
+		if(key >= 0 && key < CommonKeyCount)
+			myCommon[key] = index;
+	}
+	/* Compare before writing, myEntries may be shared and writing through it detaches */
+	else if(!strncmp(myEntries.at(index).value, value, MaxValueLength))
+		return false;
+
+	Entry& entry = myEntries[index];
+	strncpy(entry.value, value, MaxValueLength);
+	entry.value[MaxValueLength] = '\0';
+	return true;
+}
+
+bool QWInfo::set(int key, const char* value)
+{
+	if(key < 0)
+		return false;
+	return update(indexOf(key), key, NULL, value);
+}
+
+bool QWInfo::set(const char* key, const char* value)
+{
+	int id = *value ? QWInfo::key(key) : findKey(key);
+	return update(id == NoKey ? indexOf(key) : indexOf(id), id, key, value);
+}
+
+bool QWInfo::setInfoString(const char* info)
+{
+	/* Overwrites in place and drops whatever the new string doesn't have */
+	QVarLengthArray<bool, 32> seen(myEntries.size());
+	bool changed = false;
+	char key[MaxKeyLength + 1];
+	char value[MaxValueLength + 1];
+	QByteArray longKey;
+
+	for(int i = 0; i < seen.size(); ++i)
+		seen[i] = false;
+
+	while(*info == '\\')
+	{
+		const char* name = key;
+		const char* start = ++info;
+		while(*info && *info != '\\')
+			++info;
+		if(*info != '\\')
+			break;
+
+		/* Keys too long to intern are kept whole by name, not cut into another key */
+		int len = info - start;
+		if(len > MaxKeyLength)
+		{
+			longKey = QByteArray(start, len);
+			name = longKey.constData();
+		}
+		else
+		{
+			memcpy(key, start, len);
+			key[len] = '\0';
+		}
+
+		len = 0;
+		for(++info; *info && *info != '\\'; ++info)
+			if(len < MaxValueLength)
+				value[len++] = *info;
+		value[len] = '\0';
+		if(!*value)
+			continue;
+
+		int id = QWInfo::key(name);
+		int i = id == NoKey ? indexOf(name) : indexOf(id);
+		changed |= update(i, id, name, value);
+		if(i != -1 && i < seen.size())
+			seen[i] = true;
+	}
+
+	for(int i = seen.size() - 1; i >= 0; --i)
+	{
+		if(!seen[i])
+		{
+			removeAt(i);
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+void QWInfo::clear()
+{
+	myEntries.resize(0);
+	for(int i = 0; i < CommonKeyCount; ++i)
+		myCommon[i] = -1;
+}
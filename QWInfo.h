@@ -0,0 +1,115 @@
+/*
+GNU General Public License version 3 notice
+
+Copyright (C) 2012 Mihawk <luiz@netdome.biz>. All rights reserved.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see < http://www.gnu.org/licenses/ >.
+*/
+
+#ifndef QWINFO_H
+#define QWINFO_H
+
+#include "qwclient_global.h"
+#include <QByteArray>
+#include <QVector>
+
+/**
+  Parsed \key\value info string, as used for userinfo and serverinfo.
+
+  Keys are interned process wide into small integers, the common ones
+  having fixed ids so they are found without any string compare. The key
+  table is bounded, keys longer than MaxKeyLength or seen after it filled
+  up are kept by name in the QWInfo holding them instead. Values live in
+  fixed buffers that are overwritten in place, so reparsing an info string
+  whose keys didn't change doesn't allocate.
+*/
+class QWCLIENTSHARED_EXPORT QWInfo
+{
+public:
+	/* Keys with fixed ids, looked up in constant time */
+	enum CommonKey
+	{
+		Name,
+		Team,
+		TopColor,
+		BottomColor,
+		Spectator,				//*spectator
+		Skin,
+		HostName,					//hostname
+		Map,							//map
+		CommonKeyCount
+	};
+
+	enum { MaxValueLength = 63 }; //longer values are cut, the servers reject them anyway
+	enum { MaxKeyLength = 63 };		//MAX_INFO_KEY without the terminator, longer keys aren't interned
+	enum { MaxKeys = 256 };				//interned keys, common ones included
+	enum { NoKey = -1 };
+
+	QWInfo();
+
+	/**
+		Id of a key, interning it on first use.
+		Thread safe, ids are shared by every QWInfo of the process. Lookups
+		don't lock, only interning a new key does.
+
+		@return	NoKey when the key is too long or the table is full
+	*/
+	static int					key(const char* name);
+	static int					findKey(const char* name); //NoKey when the key was never interned
+	static const char*	keyName(int key);
+
+	const char*	value(int key) const; //empty string when unset
+	const char*	value(const char* key) const;
+	int					intValue(int key, int defaultValue = 0) const;
+	bool				contains(int key) const;
+
+	int					count() const;
+	int					keyAt(int index) const; //NoKey for keys that aren't interned
+	const char*	keyNameAt(int index) const;
+	const char*	valueAt(int index) const;
+
+	/**
+		Sets a single value, an empty value removes the key.
+
+		@return	True if the info changed
+	*/
+	bool	set(int key, const char* value);
+	bool	set(const char* key, const char* value);
+
+	/**
+		Replaces the content with a parsed \key\value info string.
+
+		@return	True if the info changed
+	*/
+	bool	setInfoString(const char* info);
+	void	clear();
+
+private:
+	struct Entry
+	{
+		int					key;
+		QByteArray	name;	//only for NoKey
+		char				value[MaxValueLength + 1];
+	};
+
+	QVector<Entry>	myEntries;
+	int							myCommon[CommonKeyCount];	//index in myEntries, -1 when unset
+
+	int			indexOf(int key) const;
+	int			indexOf(const char* name) const;
+	bool		update(int index, int key, const char* name, const char* value);
+	void		removeAt(int index);
+};
+
+#endif // QWINFO_H
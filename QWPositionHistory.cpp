@@ -0,0 +1,146 @@
+/*
+GNU General Public License version 3 notice
+
+Copyright (C) 2012 Mihawk <luiz@netdome.biz>. All rights reserved.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see < http://www.gnu.org/licenses/ >.
+*/
+
+#include "QWPositionHistory.h"
+
+QWPositionHistory::QWPositionHistory():
+	mySlots(0),
+	myDepth(0),
+	myMaxExtrapolation(100)
+{
+}
+
+void QWPositionHistory::resize(int slots, int depth)
+{
+	if(depth <= 0 || slots <= 0)
+	{
+		slots = 0;
+		depth = 0;
+	}
+
+	mySlots = slots;
+	myDepth = depth;
+	mySamples.resize(slots * depth);
+	myHeads.resize(slots);
+	myCounts.resize(slots);
+	clear();
+}
+
+int QWPositionHistory::slots() const
+{
+	return mySlots;
+}
+
+int QWPositionHistory::depth() const
+{
+	return myDepth;
+}
+
+void QWPositionHistory::clear()
+{
+	for(int i = 0; i < mySlots; ++i)
+	{
+		myHeads[i] = 0;
+		myCounts[i] = 0;
+	}
+}
+
+void QWPositionHistory::setMaxExtrapolation(int msecs)
+{
+	myMaxExtrapolation = msecs;
+}
+
+int QWPositionHistory::maxExtrapolation() const
+{
+	return myMaxExtrapolation;
+}
+
+void QWPositionHistory::record(int slot, qint64 time, const float* origin)
+{
+	if(slot < 0 || slot >= mySlots)
+		return;
+
+	Sample* ring = mySamples.data() + slot * myDepth;
+	int head = myHeads.at(slot);
+
+	/* Samples stay in time order, a second one for the same time replaces the first */
+	if(myCounts.at(slot))
+	{
+		int newest = head ? head - 1 : myDepth - 1;
+		if(ring[newest].time > time)
+			return;
+		if(ring[newest].time == time)
+		{
+			for(int i = 0; i < 3; ++i)
+				ring[newest].origin[i] = origin[i];
+			return;
+		}
+	}
+
+	ring[head].time = time;
+	for(int i = 0; i < 3; ++i)
+		ring[head].origin[i] = origin[i];
+	myHeads[slot] = head + 1 == myDepth ? 0 : head + 1;
+	if(myCounts.at(slot) < myDepth)
+		myCounts[slot]++;
+}
+
+bool QWPositionHistory::positionAt(int slot, qint64 time, float* origin) const
+{
+	if(slot < 0 || slot >= mySlots || !myCounts.at(slot))
+		return false;
+
+	const Sample* ring = mySamples.constData() + slot * myDepth;
+	int count = myCounts.at(slot);
+	int newest = myHeads.at(slot) ? myHeads.at(slot) - 1 : myDepth - 1;
+
+	/* Newest first, queries are usually about the present */
+	const Sample* later = &ring[newest];
+	if(time >= later->time)
+	{
+		const Sample* earlier = count > 1 ? &ring[newest ? newest - 1 : myDepth - 1] : 0;
+		qint64 ahead = qMin<qint64>(time - later->time, myMaxExtrapolation);
+		float f = earlier ? (float)ahead / (later->time - earlier->time) : 0;
+		for(int i = 0; i < 3; ++i)
+			origin[i] = later->origin[i] + (earlier ? (later->origin[i] - earlier->origin[i]) * f : 0);
+		return true;
+	}
+
+	for(int n = 1; n < count; ++n)
+	{
+		int index = newest - n;
+		if(index < 0)
+			index += myDepth;
+
+		const Sample* earlier = &ring[index];
+		if(time >= earlier->time)
+		{
+			float f = (float)(time - earlier->time) / (later->time - earlier->time);
+			for(int i = 0; i < 3; ++i)
+				origin[i] = earlier->origin[i] + (later->origin[i] - earlier->origin[i]) * f;
+			return true;
+		}
+		later = earlier;
+	}
+
+	/* Older than anything kept */
+	for(int i = 0; i < 3; ++i)
+		origin[i] = later->origin[i];
+	return true;
+}
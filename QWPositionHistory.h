@@ -0,0 +1,78 @@
+/*
+GNU General Public License version 3 notice
+
+Copyright (C) 2012 Mihawk <luiz@netdome.biz>. All rights reserved.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see < http://www.gnu.org/licenses/ >.
+*/
+
+#ifndef QWPOSITIONHISTORY_H
+#define QWPOSITIONHISTORY_H
+
+#include "qwclient_global.h"
+#include <QVector>
+
+/**
+  Keeps the last few timestamped positions of many objects and answers
+  where an object was, or probably is, at any time.
+
+  Every slot owns a fixed ring of samples inside one shared array, so
+  recording never allocates. Between samples positions are interpolated,
+  after the newest one they are extrapolated with the velocity of the
+  last two samples for a limited time.
+*/
+class QWCLIENTSHARED_EXPORT QWPositionHistory
+{
+public:
+	QWPositionHistory();
+
+	/**
+		Sizes the history, dropping every sample recorded so far.
+
+		@param	slots Number of objects tracked
+		@param	depth Samples kept per object, 0 frees the history
+	*/
+	void	resize(int slots, int depth);
+	int		slots() const;
+	int		depth() const;
+	void	clear();
+
+	void	setMaxExtrapolation(int msecs); //100 by default
+	int		maxExtrapolation() const;
+
+	void	record(int slot, qint64 time, const float* origin);
+
+	/**
+		Position of an object at the given time.
+
+		@return	False when nothing was recorded for the slot
+	*/
+	bool	positionAt(int slot, qint64 time, float* origin) const;
+
+private:
+	struct Sample
+	{
+		qint64	time;
+		float		origin[3];
+	};
+
+	int										mySlots;
+	int										myDepth;
+	int										myMaxExtrapolation;
+	QVector<Sample>				mySamples;	//myDepth samples per slot
+	QVector<int>					myHeads;		//next sample written per slot
+	QVector<int>					myCounts;		//samples recorded per slot, up to myDepth
+};
+
+#endif // QWPOSITIONHISTORY_H
@@ -0,0 +1,290 @@
+/*
+GNU General Public License version 3 notice
+
+Copyright (C) 2012 Mihawk <luiz@netdome.biz>. All rights reserved.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see < http://www.gnu.org/licenses/ >.
+*/
+
+#include "QWSpatialIndex.h"
+#include "QWEntityStore.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+static bool closerThan(const QWSpatialIndex::Hit& a, const QWSpatialIndex::Hit& b)
+{
+	return a.distance2 < b.distance2;
+}
+
+QWSpatialIndex::QWSpatialIndex(float minCellSize):
+	myMinCellSize(minCellSize),
+	myDirtyFlag(true),
+	myIndexedCount(0),
+	myCellSize(minCellSize),
+	myInverseCellSize(1.0f / minCellSize)
+{
+	myItems.resize(MaxPlayers);
+	memset(myActivePlayers, 0, sizeof(myActivePlayers));
+}
+
+int QWSpatialIndex::cellOf(float v) const
+{
+	/* floorf() is a library call without SSE4.1 */
+	float f = v * myInverseCellSize;
+	int i = (int)f;
+	return i - (f < i);
+}
+
+int QWSpatialIndex::bucketOf(int x, int y, int z)
+{
+	return ((quint32)x * 73856093u ^ (quint32)y * 19349663u ^ (quint32)z * 83492791u) & (Buckets - 1);
+}
+
+bool QWSpatialIndex::isActive(int item) const
+{
+	return item >= MaxPlayers || myActivePlayers[item];
+}
+
+void QWSpatialIndex::setPlayer(int playerNum, float x, float y, float z)
+{
+	if(playerNum < 0 || playerNum >= MaxPlayers)
+		return;
+
+	Item& item = myItems[playerNum];
+	item.origin[0] = x;
+	item.origin[1] = y;
+	item.origin[2] = z;
+	item.id = playerNum;
+	item.kind = Player;
+	myActivePlayers[playerNum] = true;
+	myDirtyFlag = true;
+}
+
+void QWSpatialIndex::removePlayer(int playerNum)
+{
+	if(playerNum < 0 || playerNum >= MaxPlayers)
+		return;
+
+	myActivePlayers[playerNum] = false;
+	myDirtyFlag = true;
+}
+
+void QWSpatialIndex::addEntity(int number, float x, float y, float z)
+{
+	Item item;
+	item.origin[0] = x;
+	item.origin[1] = y;
+	item.origin[2] = z;
+	item.id = number;
+	item.kind = Entity;
+	myItems.append(item);
+	myDirtyFlag = true;
+}
+
+void QWSpatialIndex::setEntities(const QWEntityStore& store)
+{
+	clearEntities();
+	for(int i = 0; i < store.count(); ++i)
+		addEntity(store.numbers()[i], store.originX()[i], store.originY()[i], store.originZ()[i]);
+}
+
+void QWSpatialIndex::clearEntities()
+{
+	myItems.resize(MaxPlayers);
+	myDirtyFlag = true;
+}
+
+void QWSpatialIndex::clear()
+{
+	clearEntities();
+	memset(myActivePlayers, 0, sizeof(myActivePlayers));
+}
+
+int QWSpatialIndex::count() const
+{
+	int players = 0;
+	for(int i = 0; i < MaxPlayers; ++i)
+		players += myActivePlayers[i];
+	return players + myItems.size() - MaxPlayers;
+}
+
+void QWSpatialIndex::rebuild() const
+{
+	myIndexedCount = 0;
+	for(int i = 0; i < myItems.size(); ++i)
+	{
+		if(!isActive(i))
+			continue;
+
+		const Item& item = myItems.at(i);
+		for(int j = 0; j < 3; ++j)
+		{
+			if(!myIndexedCount || item.origin[j] < myMins[j])
+				myMins[j] = item.origin[j];
+			if(!myIndexedCount || item.origin[j] > myMaxs[j])
+				myMaxs[j] = item.origin[j];
+		}
+		myIndexedCount++;
+	}
+
+	/* About two items per cell if they were spread evenly over the bounds */
+	float volume = 1;
+	for(int j = 0; j < 3; ++j)
+		volume *= qMax(myMaxs[j] - myMins[j], myMinCellSize);
+	myCellSize = qMax(myMinCellSize, cbrtf(volume * 2 / qMax(myIndexedCount, 1)));
+	myInverseCellSize = 1.0f / myCellSize;
+
+	/* Count the items per bucket, shifted by one for the prefix sum */
+	memset(myBucketStart, 0, sizeof(myBucketStart));
+	for(int i = 0; i < myItems.size(); ++i)
+	{
+		if(!isActive(i))
+			continue;
+
+		const Item& item = myItems.at(i);
+		for(int j = 0; j < 3; ++j)
+			item.cell[j] = cellOf(item.origin[j]);
+		myBucketStart[bucketOf(item.cell[0], item.cell[1], item.cell[2]) + 1]++;
+	}
+
+	for(int b = 0; b < Buckets; ++b)
+		myBucketStart[b + 1] += myBucketStart[b];
+
+	int fill[Buckets];
+	memcpy(fill, myBucketStart, sizeof(fill));
+	myOrder.resize(myIndexedCount);
+	for(int i = 0; i < myItems.size(); ++i)
+	{
+		if(!isActive(i))
+			continue;
+
+		const Item& item = myItems.at(i);
+		myOrder[fill[bucketOf(item.cell[0], item.cell[1], item.cell[2])]++] = i;
+	}
+
+	myDirtyFlag = false;
+}
+
+int QWSpatialIndex::collect(float x, float y, float z, float radius, int kinds, Hit* hits, int maxHits) const
+{
+	float radius2 = radius * radius;
+	int found = 0;
+	int c0[3] = { cellOf(x - radius), cellOf(y - radius), cellOf(z - radius) };
+	int c1[3] = { cellOf(x + radius), cellOf(y + radius), cellOf(z + radius) };
+	qint64 cells = (qint64)(c1[0] - c0[0] + 1) * (c1[1] - c0[1] + 1) * (c1[2] - c0[2] + 1);
+
+	/* Large spheres visit fewer items by scanning everything */
+	if(cells > myIndexedCount)
+	{
+		for(int o = 0; o < myOrder.size() && found < maxHits; ++o)
+		{
+			const Item& item = myItems.at(myOrder.at(o));
+			float dx = item.origin[0] - x;
+			float dy = item.origin[1] - y;
+			float dz = item.origin[2] - z;
+			float d2 = dx * dx + dy * dy + dz * dz;
+			if(!(item.kind & kinds) || d2 > radius2)
+				continue;
+			hits[found].kind = item.kind;
+			hits[found].id = item.id;
+			hits[found].distance2 = d2;
+			found++;
+		}
+		return found;
+	}
+
+	for(int cx = c0[0]; cx <= c1[0]; ++cx)
+	{
+		for(int cy = c0[1]; cy <= c1[1]; ++cy)
+		{
+			for(int cz = c0[2]; cz <= c1[2]; ++cz)
+			{
+				int b = bucketOf(cx, cy, cz);
+				for(int o = myBucketStart[b]; o < myBucketStart[b + 1]; ++o)
+				{
+					const Item& item = myItems.at(myOrder.at(o));
+
+					/* Other cells hashing to the same bucket are visited on their own turn */
+					if(item.cell[0] != cx || item.cell[1] != cy || item.cell[2] != cz || !(item.kind & kinds))
+						continue;
+
+					float dx = item.origin[0] - x;
+					float dy = item.origin[1] - y;
+					float dz = item.origin[2] - z;
+					float d2 = dx * dx + dy * dy + dz * dz;
+					if(d2 > radius2)
+						continue;
+					if(found == maxHits)
+						return found;
+					hits[found].kind = item.kind;
+					hits[found].id = item.id;
+					hits[found].distance2 = d2;
+					found++;
+				}
+			}
+		}
+	}
+	return found;
+}
+
+int QWSpatialIndex::withinRadius(float x, float y, float z, float radius, int kinds, Hit* hits, int maxHits) const
+{
+	if(myDirtyFlag)
+		rebuild();
+
+	return collect(x, y, z, radius, kinds, hits, maxHits);
+}
+
+int QWSpatialIndex::nearest(float x, float y, float z, int k, int kinds, Hit* hits) const
+{
+	if(myDirtyFlag)
+		rebuild();
+
+	if(k <= 0 || !myIndexedCount)
+		return 0;
+
+	/* Farthest any item can be, once the sphere covers it every item is a candidate */
+	float reach2 = 0;
+	for(int j = 0; j < 3; ++j)
+	{
+		float v = j == 0 ? x : (j == 1 ? y : z);
+		float d = qMax(qAbs(v - myMins[j]), qAbs(myMaxs[j] - v));
+		reach2 += d * d;
+	}
+
+	/* Start with the sphere that holds k items if they were spread evenly over the bounds */
+	float volume = 1;
+	for(int j = 0; j < 3; ++j)
+		volume *= qMax(myMaxs[j] - myMins[j], myMinCellSize);
+	float radius = qMax(myMinCellSize, cbrtf(volume * k / (myIndexedCount * 4.18879f)));
+
+	myCandidates.resize(myIndexedCount);
+	for(;;)
+	{
+		int found = collect(x, y, z, radius, kinds, myCandidates.data(), myCandidates.size());
+
+		/* Anything outside the sphere is farther than everything inside it */
+		if(found >= k || radius * radius >= reach2)
+		{
+			int n = qMin(k, found);
+			Hit* candidates = myCandidates.data();
+			std::partial_sort(candidates, candidates + n, candidates + found, closerThan);
+			for(int i = 0; i < n; ++i)
+				hits[i] = candidates[i];
+			return n;
+		}
+		radius *= 1.5f;
+	}
+}
@@ -0,0 +1,110 @@
+/*
+GNU General Public License version 3 notice
+
+Copyright (C) 2012 Mihawk <luiz@netdome.biz>. All rights reserved.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see < http://www.gnu.org/licenses/ >.
+*/
+
+#ifndef QWSPATIALINDEX_H
+#define QWSPATIALINDEX_H
+
+#include "qwclient_global.h"
+#include <QVector>
+
+class QWEntityStore;
+
+/**
+  Uniform grid over player and entity positions for proximity queries.
+
+  Positions are updated as they arrive, the grid itself is rebuilt lazily
+  by the first query after a change. A rebuild is a counting sort of the
+  items into hashed cells, linear in the number of items. The cell size
+  follows the item density so that a cell holds a couple of items.
+*/
+class QWCLIENTSHARED_EXPORT QWSpatialIndex
+{
+public:
+	enum Kind { Player = 1, Entity = 2, Any = Player | Entity };
+
+	struct Hit
+	{
+		Kind	kind;
+		int		id;					//player slot or entity number
+		float	distance2;	//squared distance to the query point
+	};
+
+	QWSpatialIndex(float minCellSize = 64.0f);
+
+	void	setPlayer(int playerNum, float x, float y, float z);
+	void	removePlayer(int playerNum);
+	void	addEntity(int number, float x, float y, float z);
+	void	setEntities(const QWEntityStore& store); //replaces all entities
+	void	clearEntities();
+	void	clear();
+	int		count() const;
+
+	/**
+		Collects everything inside a sphere, unsorted.
+
+		@param	kinds Player, Entity or Any
+		@param	hits Receives the results
+		@param	maxHits Size of hits
+		@return	The number of hits written
+	*/
+	int		withinRadius(float x, float y, float z, float radius, int kinds, Hit* hits, int maxHits) const;
+
+	/**
+		Finds the k closest items, sorted by distance.
+
+		@return	The number of hits written, less than k when there aren't enough items
+	*/
+	int		nearest(float x, float y, float z, int k, int kinds, Hit* hits) const;
+
+private:
+	enum { MaxPlayers = 32, BucketBits = 10, Buckets = 1 << BucketBits };
+
+	struct Item
+	{
+		float	origin[3];
+		mutable int cell[3];	//assigned by rebuild()
+		int		id;
+		Kind	kind;
+	};
+
+	float								myMinCellSize;
+
+	/* Players live in the first MaxPlayers slots, entities after them */
+	QVector<Item>				myItems;
+	bool								myActivePlayers[MaxPlayers];
+
+	/* Built on demand, myOrder holds item indices grouped by bucket */
+	mutable bool				myDirtyFlag;
+	mutable QVector<int>	myOrder;
+	mutable int					myBucketStart[Buckets + 1];
+	mutable float				myMins[3];
+	mutable float				myMaxs[3];
+	mutable int					myIndexedCount;
+	mutable float				myCellSize;
+	mutable float				myInverseCellSize;
+	mutable QVector<Hit>	myCandidates;		//scratch for nearest()
+
+	int		cellOf(float v) const;
+	static int bucketOf(int x, int y, int z);
+	bool	isActive(int item) const;
+	void	rebuild() const;
+	int		collect(float x, float y, float z, float radius, int kinds, Hit* hits, int maxHits) const;
+};
+
+#endif // QWSPATIALINDEX_H
@@ -0,0 +1,98 @@
+/*
+GNU General Public License version 3 notice
+
+Copyright (C) 2012 Mihawk <luiz@netdome.biz>. All rights reserved.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see < http://www.gnu.org/licenses/ >.
+*/
+
+#include "QWWorldSnapshot.h"
+#include <string.h>
+
+QWWorldSnapshot::Data::Data():
+	sequence(0),
+	time(0)
+{
+	memset(players, 0, sizeof(players));
+	memset(scoreboard, 0, sizeof(scoreboard));
+	memset(stats, 0, sizeof(stats));
+	for(int i = 0; i < 32; ++i)
+	{
+		players[i].number = i;
+		scoreboard[i].number = i;
+	}
+}
+
+QWWorldSnapshot::QWWorldSnapshot()
+{
+}
+
+QWWorldSnapshot::QWWorldSnapshot(Data* data):
+	d(data)
+{
+}
+
+const QWWorldSnapshot::Data* QWWorldSnapshot::data() const
+{
+	static const Data empty;
+	return d ? d.constData() : &empty;
+}
+
+bool QWWorldSnapshot::isNull() const
+{
+	return !d;
+}
+
+quint32 QWWorldSnapshot::sequence() const
+{
+	return data()->sequence;
+}
+
+qint64 QWWorldSnapshot::time() const
+{
+	return data()->time;
+}
+
+const QWClient::PlayerState& QWWorldSnapshot::player(int playerNum) const
+{
+	static const QWClient::PlayerState none = QWClient::PlayerState();
+
+	if(playerNum < 0 || playerNum >= 32)
+		return none;
+	return data()->players[playerNum];
+}
+
+const QWClient::ScoreboardEntry& QWWorldSnapshot::scoreboard(int playerNum) const
+{
+	static const QWClient::ScoreboardEntry none = QWClient::ScoreboardEntry();
+
+	if(playerNum < 0 || playerNum >= 32)
+		return none;
+	return data()->scoreboard[playerNum];
+}
+
+const int* QWWorldSnapshot::stats() const
+{
+	return data()->stats;
+}
+
+const QWEntityStore& QWWorldSnapshot::entities() const
+{
+	return data()->entities;
+}
+
+const QWInfo& QWWorldSnapshot::serverInfo() const
+{
+	return data()->serverInfo;
+}
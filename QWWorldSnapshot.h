@@ -0,0 +1,74 @@
+/*
+GNU General Public License version 3 notice
+
+Copyright (C) 2012 Mihawk <luiz@netdome.biz>. All rights reserved.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see < http://www.gnu.org/licenses/ >.
+*/
+
+#ifndef QWWORLDSNAPSHOT_H
+#define QWWORLDSNAPSHOT_H
+
+#include "qwclient_global.h"
+#include "QWClient.h"
+#include "QWEntityStore.h"
+#include "QWInfo.h"
+#include <QExplicitlySharedDataPointer>
+#include <QSharedData>
+
+/**
+  Immutable copy of a client's world, published after every parsed server
+  message when snapshot publishing is enabled.
+
+  Copies share the same data through an atomic reference count, so a
+  snapshot taken on another thread stays consistent for as long as it is
+  held while the network thread keeps parsing into newer ones.
+*/
+class QWCLIENTSHARED_EXPORT QWWorldSnapshot
+{
+	friend class QWClientPrivate;
+public:
+	QWWorldSnapshot();
+
+	bool											isNull() const;
+	quint32										sequence() const; //incoming sequence of the message that produced it
+	qint64										time() const; //QWClient::clock() when it was published
+
+	const QWClient::PlayerState&		player(int playerNum) const;
+	const QWClient::ScoreboardEntry& scoreboard(int playerNum) const;
+	const int*											stats() const; //QWClient::StatCount stats of the tracked player
+	const QWEntityStore&						entities() const;
+	const QWInfo&										serverInfo() const;
+
+private:
+	struct Data: public QSharedData
+	{
+		Data();
+
+		quint32										sequence;
+		qint64										time;
+		QWClient::PlayerState			players[32];
+		QWClient::ScoreboardEntry	scoreboard[32];
+		int												stats[QWClient::StatCount];
+		QWEntityStore							entities;
+		QWInfo										serverInfo;
+	};
+
+	QExplicitlySharedDataPointer<Data> d;
+
+	QWWorldSnapshot(Data* data);
+	const Data*	data() const;
+};
+
+#endif // QWWORLDSNAPSHOT_H
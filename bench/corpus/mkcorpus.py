@@ -0,0 +1,539 @@
+#!/usr/bin/env python3
+#
+# Writes the synthetic captures of the benchmark corpus.
+#
+# The datagrams are built from the protocol as the parser reads it, with a
+# fixed random seed so the files only change when this script does.
+# Usage: mkcorpus.py [output folder], the folder of the script by default.
+
+import os
+import random
+import struct
+import sys
+
+PROTOCOL_VERSION = 28
+PROTOCOL_VERSION_FTE = ord('F') | ord('T') << 8 | ord('E') << 16 | ord('X') << 24
+
+FTE_PEXT_TRANS = 0x00000008
+FTE_PEXT_MODELDBL = 0x00001000
+FTE_PEXT_ENTITYDBL = 0x00002000
+FTE_PEXT_ENTITYDBL2 = 0x00004000
+FTE_PEXT_FLOATCOORDS = 0x00008000
+FTE_PEXT_SPAWNSTATIC2 = 0x00400000
+
+svc_updatestat = 3
+svc_sound = 6
+svc_print = 8
+svc_stufftext = 9
+svc_serverdata = 11
+svc_lightstyle = 12
+svc_updatefrags = 14
+svc_damage = 19
+svc_spawnstatic = 20
+svc_fte_spawnstatic2 = 21
+svc_spawnbaseline = 22
+svc_temp_entity = 23
+svc_cdtrack = 32
+svc_updateping = 36
+svc_updateentertime = 37
+svc_updatestatlong = 38
+svc_muzzleflash = 39
+svc_updateuserinfo = 40
+svc_download = 41
+svc_playerinfo = 42
+svc_chokecount = 44
+svc_modellist = 45
+svc_soundlist = 46
+svc_packetentities = 47
+svc_deltapacketentities = 48
+svc_maxspeed = 49
+svc_setinfo = 51
+svc_serverinfo = 52
+svc_updatepl = 53
+svc_nails2 = 54
+svc_fte_modellistshort = 60
+svc_fte_spawnbaseline2 = 66
+
+PF_MSEC = 1 << 0
+PF_COMMAND = 1 << 1
+PF_VELOCITY1 = 1 << 2
+PF_VELOCITY2 = 1 << 3
+PF_VELOCITY3 = 1 << 4
+PF_WEAPONFRAME = 1 << 8
+
+CM_ANGLE1 = 1 << 0
+CM_FORWARD = 1 << 2
+CM_SIDE = 1 << 3
+CM_BUTTONS = 1 << 5
+CM_ANGLE2 = 1 << 7
+
+U_ANGLE1 = 1 << 0
+U_ANGLE3 = 1 << 1
+U_MODEL = 1 << 2
+U_SKIN = 1 << 4
+U_ORIGIN1 = 1 << 9
+U_ORIGIN2 = 1 << 10
+U_ORIGIN3 = 1 << 11
+U_ANGLE2 = 1 << 12
+U_FRAME = 1 << 13
+U_REMOVE = 1 << 14
+U_MOREBITS = 1 << 15
+U_FTE_EVENMORE = 1 << 7
+U_FTE_ENTITYDBL = 1 << 5
+U_FTE_ENTITYDBL2 = 1 << 6
+
+TE_SPIKE = 0
+TE_GUNSHOT = 2
+TE_EXPLOSION = 3
+TE_LIGHTNING2 = 6
+TE_BLOOD = 12
+
+SND_VOLUME = 1 << 15
+SND_ATTENUATION = 1 << 14
+
+SOUNDS = ["weapons/rocket1i.wav", "weapons/sgun1.wav", "weapons/guncock.wav", "weapons/lhit.wav",
+          "weapons/spike2.wav", "weapons/r_exp3.wav", "player/pain1.wav", "player/death1.wav",
+          "items/armor1.wav", "items/health1.wav", "misc/water1.wav", "doors/drclos4.wav"]
+MODELS = ["progs/player.mdl", "progs/eyes.mdl", "progs/h_player.mdl", "progs/gib1.mdl",
+          "progs/missile.mdl", "progs/grenade.mdl", "progs/spike.mdl", "progs/armor.mdl",
+          "progs/backpack.mdl", "progs/g_rock2.mdl", "progs/g_light.mdl", "maps/b_bh25.bsp"]
+NAMES = ["zero", "milton", "bps", "locktar", "reppie", "carapace", "griffin", "hangtime"]
+
+
+class Message:
+    def __init__(self, floatCoords=False):
+        self.data = bytearray()
+        self.floatCoords = floatCoords
+
+    def byte(self, v):
+        self.data += struct.pack("<B", v & 0xff)
+
+    def short(self, v):
+        self.data += struct.pack("<h", v)
+
+    def ushort(self, v):
+        self.data += struct.pack("<H", v & 0xffff)
+
+    def long(self, v):
+        self.data += struct.pack("<I", v & 0xffffffff)
+
+    def float(self, v):
+        self.data += struct.pack("<f", v)
+
+    def string(self, s):
+        self.data += s.encode("latin-1") + b"\0"
+
+    def coord(self, v):
+        if self.floatCoords:
+            self.float(v)
+        else:
+            self.short(int(v * 8))
+
+    def angle(self, v):
+        if self.floatCoords:
+            self.ushort(int(v * 65536 / 360))
+        else:
+            self.byte(int(v * 256 / 360))
+
+
+class Capture:
+    def __init__(self):
+        self.datagrams = []
+        self.sequence = 0
+
+    def connectionless(self, payload):
+        self.datagrams.append(b"\xff\xff\xff\xff" + payload)
+
+    def packet(self, message, reliable=False):
+        self.sequence += 1
+        header = struct.pack("<II", self.sequence | (reliable << 31), self.sequence)
+        self.datagrams.append(header + bytes(message.data))
+
+    def write(self, fileName):
+        with open(fileName, "wb") as f:
+            for d in self.datagrams:
+                f.write(struct.pack("<I", len(d)))
+                f.write(d)
+
+
+def serverdata(m, extensions, mapName):
+    m.byte(svc_serverdata)
+    if extensions:
+        m.long(PROTOCOL_VERSION_FTE)
+        m.long(extensions)
+    m.long(PROTOCOL_VERSION)
+    m.long(1)
+    m.string("qw")
+    m.byte(0x80)
+    m.string(mapName)
+    for v in (800, 4, 0.25, 320, 2000, 10, 100, 0.7, 1, 4):
+        m.float(v)
+
+
+def userinfo(m, slot, name, team):
+    m.byte(svc_updateuserinfo)
+    m.byte(slot)
+    m.long(100 + slot)
+    m.string("\\name\\%s\\team\\%s\\topcolor\\%d\\bottomcolor\\%d\\skin\\base\\*client\\ezQuake 1.9"
+             % (name, team, slot % 14, (slot * 3) % 14))
+
+
+def signon(capture, rnd, extensions=0, mapName="maps/dm3.bsp", download=False, entities=None):
+    """Connection, serverdata, lists, baselines and the scoreboard"""
+    fc = bool(extensions & FTE_PEXT_FLOATCOORDS)
+    capture.connectionless(b"j")
+
+    m = Message(fc)
+    serverdata(m, extensions, "The Abandoned Base")
+    m.byte(svc_stufftext)
+    m.string("fullserverinfo \"\\maxclients\\16\\timelimit\\20\\fraglimit\\0\\teamplay\\2\\deathmatch\\1"
+             "\\hostname\\bench server\\map\\%s\\*version\\MVDSV 0.36\\*gamedir\\qw\"\n" % mapName[5:-4])
+    capture.packet(m, True)
+
+    m = Message(fc)
+    m.byte(svc_soundlist)
+    m.byte(0)
+    for s in SOUNDS:
+        m.string(s)
+    m.byte(0)
+    m.byte(0)
+    capture.packet(m, True)
+
+    m = Message(fc)
+    if download:
+        m.byte(svc_fte_modellistshort)
+        m.short(0)
+    else:
+        m.byte(svc_modellist)
+        m.byte(0)
+    m.string(mapName)
+    for s in MODELS:
+        m.string(s)
+    m.byte(0)
+    m.byte(0)
+    capture.packet(m, True)
+
+    if download:
+        size = 96 * 1024
+        chunk = 1024
+        for offset in range(0, size, chunk):
+            m = Message(fc)
+            m.byte(svc_download)
+            m.short(chunk)
+            m.byte((offset + chunk) * 100 // size)
+            m.data += bytes(rnd.getrandbits(8) for _ in range(chunk))
+            capture.packet(m, True)
+
+    m = Message(fc)
+    for number, e in sorted(entities.items()):
+        if extensions & FTE_PEXT_SPAWNSTATIC2:
+            m.byte(svc_fte_spawnbaseline2)
+            delta(m, number, None, e)
+        else:
+            m.byte(svc_spawnbaseline)
+            m.short(number)
+            m.byte(e["model"])
+            m.byte(e["frame"])
+            m.byte(0)
+            m.byte(e["skin"])
+            for i in range(3):
+                m.coord(e["origin"][i])
+                m.angle(e["angles"][i])
+        if len(m.data) > 1300:
+            capture.packet(m, True)
+            m = Message(fc)
+    for i in range(20):
+        if extensions & FTE_PEXT_SPAWNSTATIC2:
+            m.byte(svc_fte_spawnstatic2)
+            delta(m, 1, None, {"model": 11, "frame": 0, "skin": 0, "origin": randomOrigin(rnd), "angles": [0, 0, 0]})
+        else:
+            m.byte(svc_spawnstatic)
+            m.byte(11)
+            m.byte(0)
+            m.byte(0)
+            m.byte(0)
+            o = randomOrigin(rnd)
+            for j in range(3):
+                m.coord(o[j])
+                m.angle(0)
+    for i in range(12):
+        m.byte(svc_lightstyle)
+        m.byte(i)
+        m.string("mmnmmommommnonmmonqnmmo"[:10 + i])
+    m.byte(svc_cdtrack)
+    m.byte(4)
+    capture.packet(m, True)
+
+    m = Message(fc)
+    for slot, name in enumerate(NAMES):
+        m.byte(svc_updatefrags)
+        m.byte(slot)
+        m.short(rnd.randint(0, 40))
+        m.byte(svc_updateping)
+        m.byte(slot)
+        m.short(rnd.randint(10, 80))
+        m.byte(svc_updatepl)
+        m.byte(slot)
+        m.byte(0)
+        m.byte(svc_updateentertime)
+        m.byte(slot)
+        m.float(rnd.uniform(10, 600))
+        userinfo(m, slot, name, "red" if slot < 4 else "blue")
+    m.byte(svc_serverinfo)
+    m.string("status")
+    m.string("8 min left")
+    m.byte(svc_maxspeed)
+    m.float(320)
+    m.byte(svc_stufftext)
+    m.string("skins\n")
+    capture.packet(m, True)
+
+
+def randomOrigin(rnd):
+    return [rnd.uniform(-2000, 2000), rnd.uniform(-2000, 2000), rnd.uniform(-200, 400)]
+
+
+def entityWord(m, number, bits):
+    """Delta header, entities past 511 need the FTE extension byte for the high bits"""
+    more = 0
+    if number & 512:
+        more |= U_FTE_ENTITYDBL
+    if number & 1024:
+        more |= U_FTE_ENTITYDBL2
+    if more:
+        bits |= U_MOREBITS | U_FTE_EVENMORE
+    elif bits & 0xff:
+        bits |= U_MOREBITS
+    m.ushort((bits & ~0x1ff) | (number & 511))
+    if bits & U_MOREBITS:
+        m.byte(bits & 0xff)
+    if more:
+        m.byte(more)
+    return bits
+
+
+def delta(m, number, old, new):
+    """Entity delta, full when old is None"""
+    bits = 0
+    if old is None or new["model"] != old["model"]:
+        bits |= U_MODEL
+    if old is None or new["frame"] != old["frame"]:
+        bits |= U_FRAME
+    if old is None or new["skin"] != old["skin"]:
+        bits |= U_SKIN
+    for i, b in enumerate((U_ORIGIN1, U_ORIGIN2, U_ORIGIN3)):
+        if old is None or new["origin"][i] != old["origin"][i]:
+            bits |= b
+    for i, b in enumerate((U_ANGLE1, U_ANGLE2, U_ANGLE3)):
+        if old is None or new["angles"][i] != old["angles"][i]:
+            bits |= b
+    bits = entityWord(m, number, bits)
+    if bits & U_MODEL:
+        m.byte(new["model"])
+    if bits & U_FRAME:
+        m.byte(new["frame"])
+    if bits & U_SKIN:
+        m.byte(new["skin"])
+    if bits & U_ORIGIN1:
+        m.coord(new["origin"][0])
+    if bits & U_ANGLE1:
+        m.angle(new["angles"][0])
+    if bits & U_ORIGIN2:
+        m.coord(new["origin"][1])
+    if bits & U_ANGLE2:
+        m.angle(new["angles"][1])
+    if bits & U_ORIGIN3:
+        m.coord(new["origin"][2])
+    if bits & U_ANGLE3:
+        m.angle(new["angles"][2])
+
+
+def makeEntities(rnd, count):
+    entities = {}
+    for i in range(count):
+        entities[33 + i * 3] = {"model": rnd.randint(2, 12), "frame": 0, "skin": 0,
+                                "origin": randomOrigin(rnd), "angles": [0, rnd.uniform(0, 360), 0]}
+    return entities
+
+
+def gameplay(capture, rnd, entities, frames, players, fc=False):
+    """Busy mid-game traffic, every frame has the players and the full entity list"""
+    origins = [randomOrigin(rnd) for _ in range(players)]
+    for frame in range(frames):
+        m = Message(fc)
+        for slot in range(players):
+            o = origins[slot]
+            for i in range(2):
+                o[i] += rnd.uniform(-12, 12)
+            flags = PF_MSEC | PF_COMMAND | PF_VELOCITY1 | PF_VELOCITY2
+            if frame % 7 == 0:
+                flags |= PF_VELOCITY3
+            if slot == 0:
+                flags |= PF_WEAPONFRAME
+            m.byte(svc_playerinfo)
+            m.byte(slot)
+            m.ushort(flags)
+            for i in range(3):
+                m.coord(o[i])
+            m.byte(rnd.randint(0, 5))
+            m.byte(rnd.randint(0, 40))
+            m.byte(CM_ANGLE1 | CM_ANGLE2 | CM_FORWARD | CM_SIDE | CM_BUTTONS)
+            m.ushort(rnd.randint(0, 65535))
+            m.ushort(rnd.randint(0, 65535))
+            m.short(rnd.choice((-320, 0, 320)))
+            m.short(rnd.choice((-320, 0, 320)))
+            m.byte(rnd.randint(0, 3))
+            m.byte(13)
+            m.short(rnd.randint(-320, 320))
+            m.short(rnd.randint(-320, 320))
+            if flags & PF_VELOCITY3:
+                m.short(rnd.randint(-200, 270))
+            if flags & PF_WEAPONFRAME:
+                m.byte(rnd.randint(0, 6))
+
+        for number, e in entities.items():
+            if rnd.random() < 0.3:
+                e["origin"][0] += rnd.uniform(-30, 30)
+                e["origin"][1] += rnd.uniform(-30, 30)
+                e["frame"] = (e["frame"] + 1) % 8
+        m.byte(svc_packetentities)
+        for number, e in sorted(entities.items()):
+            delta(m, number, None, e)
+        m.ushort(0)
+
+        r = rnd.random()
+        if r < 0.5:
+            m.byte(svc_sound)
+            m.ushort(SND_VOLUME | (rnd.randint(1, 31) << 3) | rnd.randint(0, 7))
+            m.byte(255)
+            m.byte(rnd.randint(1, len(SOUNDS)))
+            for i in range(3):
+                m.coord(rnd.uniform(-2000, 2000))
+        if r < 0.3:
+            m.byte(svc_temp_entity)
+            te = rnd.choice((TE_SPIKE, TE_GUNSHOT, TE_EXPLOSION, TE_LIGHTNING2, TE_BLOOD))
+            m.byte(te)
+            if te == TE_LIGHTNING2:
+                m.short(rnd.randint(1, players))
+                for i in range(6):
+                    m.coord(rnd.uniform(-2000, 2000))
+            else:
+                if te in (TE_GUNSHOT, TE_BLOOD):
+                    m.byte(rnd.randint(1, 20))
+                for i in range(3):
+                    m.coord(rnd.uniform(-2000, 2000))
+        if r < 0.2:
+            m.byte(svc_nails2)
+            count = rnd.randint(1, 6)
+            m.byte(count)
+            for i in range(count):
+                m.byte(i)
+                m.data += bytes(rnd.getrandbits(8) for _ in range(6))
+        if r < 0.1:
+            m.byte(svc_damage)
+            m.byte(rnd.randint(0, 50))
+            m.byte(rnd.randint(0, 50))
+            for i in range(3):
+                m.coord(rnd.uniform(-2000, 2000))
+            m.byte(svc_updatestat)
+            m.byte(0)
+            m.byte(rnd.randint(1, 100))
+            m.byte(svc_updatestatlong)
+            m.byte(15)
+            m.long(rnd.getrandbits(24))
+            m.byte(svc_muzzleflash)
+            m.short(rnd.randint(1, players))
+        if r < 0.03:
+            killer, victim = rnd.sample(NAMES[:players], 2)
+            m.byte(svc_print)
+            m.byte(1)
+            m.string("%s rides %s's rocket\n" % (victim, killer))
+            m.byte(svc_updatefrags)
+            m.byte(NAMES.index(killer))
+            m.short(rnd.randint(0, 60))
+        if frame % 100 == 50:
+            m.byte(svc_chokecount)
+            m.byte(rnd.randint(1, 5))
+            slot = rnd.randint(0, players - 1)
+            m.byte(svc_setinfo)
+            m.byte(slot)
+            m.string("team")
+            m.string(rnd.choice(("red", "blue")))
+            for slot in range(players):
+                m.byte(svc_updateping)
+                m.byte(slot)
+                m.short(rnd.randint(10, 80))
+                m.byte(svc_updatepl)
+                m.byte(slot)
+                m.byte(rnd.randint(0, 3))
+        capture.packet(m)
+
+
+def removals(capture, rnd, entities, frames, fc):
+    """
+    Delta frames against the previous full frame that remove an entity past 511 and update
+    the one after it. The remove carries the FTE extension bytes but no fields, a parser not
+    consuming them reads the rest of the frame out of sync.
+    """
+    high = {520: None, 700: None, 1100: None}
+    for number in high:
+        high[number] = {"model": rnd.randint(2, 12), "frame": 0, "skin": 0,
+                        "origin": randomOrigin(rnd), "angles": [0, rnd.uniform(0, 360), 0]}
+    entities = dict(entities)
+    entities.update(high)
+
+    for frame in range(frames):
+        m = Message(fc)
+        m.byte(svc_packetentities)
+        for number, e in sorted(entities.items()):
+            delta(m, number, None, e)
+        m.ushort(0)
+        capture.packet(m)
+
+        old = dict(high[700], origin=list(high[700]["origin"]))
+        high[700]["origin"][0] += rnd.uniform(-30, 30)
+        removed = rnd.choice((520, 1100))
+        m = Message(fc)
+        m.byte(svc_deltapacketentities)
+        m.byte(capture.sequence)
+        for number in sorted((removed, 700)):
+            if number == removed:
+                entityWord(m, number, U_REMOVE)
+            else:
+                delta(m, number, old, high[number])
+        m.ushort(0)
+        capture.packet(m)
+
+
+def main():
+    folder = sys.argv[1] if len(sys.argv) > 1 else os.path.dirname(os.path.abspath(__file__))
+
+    rnd = random.Random(27)
+    c = Capture()
+    signon(c, rnd, entities=makeEntities(rnd, 40))
+    c.write(os.path.join(folder, "signon.qwcap"))
+
+    rnd = random.Random(4)
+    c = Capture()
+    entities = makeEntities(rnd, 48)
+    signon(c, rnd, entities=entities)
+    gameplay(c, rnd, entities, 400, 8)
+    c.write(os.path.join(folder, "4on4.qwcap"))
+
+    rnd = random.Random(41)
+    c = Capture()
+    signon(c, rnd, mapName="maps/qwbench.bsp", download=True, entities=makeEntities(rnd, 20))
+    c.write(os.path.join(folder, "download.qwcap"))
+
+    rnd = random.Random(15)
+    c = Capture()
+    extensions = FTE_PEXT_FLOATCOORDS | FTE_PEXT_TRANS | FTE_PEXT_MODELDBL | FTE_PEXT_ENTITYDBL | FTE_PEXT_ENTITYDBL2 | FTE_PEXT_SPAWNSTATIC2
+    entities = makeEntities(rnd, 32)
+    signon(c, rnd, extensions, entities=entities)
+    gameplay(c, rnd, entities, 400, 8, fc=True)
+    removals(c, rnd, entities, 50, fc=True)
+    c.write(os.path.join(folder, "fte-floatcoords.qwcap"))
+
+
+if __name__ == "__main__":
+    main()
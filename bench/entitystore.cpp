@@ -0,0 +1,127 @@
+/*
+GNU General Public License version 3 notice
+
+Copyright (C) 2012 Mihawk <luiz@netdome.biz>. All rights reserved.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see < http://www.gnu.org/licenses/ >.
+*/
+
+/*
+	Compares the "which rockets are near a player" scan over an array of
+	QWClient::EntityState structs against the same scan over QWEntityStore.
+*/
+
+#include "QWClient.h"
+#include "QWEntityStore.h"
+#include <QElapsedTimer>
+#include <QVector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum { PlayerModel = 1, RocketModel = 2, Players = 8, Rockets = 16 };
+
+static const float ourRadius = 300.0f;
+
+static int scanAoS(const QVector<QWClient::EntityState>& entities)
+{
+	float radius2 = ourRadius * ourRadius;
+	int hits = 0;
+
+	for(int p = 0; p < entities.size(); ++p)
+	{
+		const QWClient::EntityState& player = entities.at(p);
+		if(player.modelIndex != PlayerModel)
+			continue;
+
+		for(int r = 0; r < entities.size(); ++r)
+		{
+			const QWClient::EntityState& rocket = entities.at(r);
+			if(rocket.modelIndex != RocketModel)
+				continue;
+
+			float dx = rocket.origin[0] - player.origin[0];
+			float dy = rocket.origin[1] - player.origin[1];
+			float dz = rocket.origin[2] - player.origin[2];
+			if(dx * dx + dy * dy + dz * dz <= radius2)
+				hits++;
+		}
+	}
+	return hits;
+}
+
+struct HitCounter
+{
+	int* hits;
+	void operator()(int) const { (*hits)++; }
+};
+
+static int scanSoA(const QWEntityStore& store)
+{
+	int players[QWEntityStore::Capacity];
+	int playerCount = store.withModel(PlayerModel, players, QWEntityStore::Capacity);
+	int hits = 0;
+	HitCounter counter = { &hits };
+
+	for(int p = 0; p < playerCount; ++p)
+	{
+		int i = players[p];
+		store.forEachWithinRadius(store.originX()[i], store.originY()[i], store.originZ()[i], ourRadius, RocketModel, counter);
+	}
+	return hits;
+}
+
+void benchEntityStore(int passes)
+{
+	QVector<QWClient::EntityState> entities;
+	QWEntityStore store;
+
+	/* A full frame, players and rockets spread over a map sized cube */
+	srand(1);
+	for(int i = 0; i < QWEntityStore::Capacity; ++i)
+	{
+		QWClient::EntityState state;
+		memset(&state, 0, sizeof(state));
+		state.number = i + 1;
+		for(int j = 0; j < 3; ++j)
+			state.origin[j] = (rand() % 4096) - 2048.0f;
+		if(i < Players)
+			state.modelIndex = PlayerModel;
+		else if(i < Players + Rockets)
+			state.modelIndex = RocketModel;
+		else
+			state.modelIndex = 3 + i % 8;
+		entities.append(state);
+		store.append(state);
+	}
+
+	int iterations = passes * 100000;
+	QElapsedTimer timer;
+	volatile int sink = 0;
+
+	timer.start();
+	for(int i = 0; i < iterations; ++i)
+		sink += scanAoS(entities);
+	qint64 aosNsecs = timer.nsecsElapsed();
+
+	timer.restart();
+	for(int i = 0; i < iterations; ++i)
+		sink += scanSoA(store);
+	qint64 soaNsecs = timer.nsecsElapsed();
+
+	printf("entity scan, %d entities, %d players x %d rockets, radius %.0f\n", (int)QWEntityStore::Capacity, (int)Players, (int)Rockets, ourRadius);
+	printf("  AoS  %8.1f ns/frame\n", (double)aosNsecs / iterations);
+	printf("  SoA  %8.1f ns/frame\n", (double)soaNsecs / iterations);
+	printf("  hits %d/%d\n\n", scanAoS(entities), scanSoA(store));
+}
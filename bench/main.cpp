@@ -0,0 +1,303 @@
+/*
+GNU General Public License version 3 notice
+
+Copyright (C) 2012 Mihawk <luiz@netdome.biz>. All rights reserved.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see < http://www.gnu.org/licenses/ >.
+*/
+
+/*
+	Replays captured server datagrams through the parser and reports
+	packets/sec, ns/packet and allocations/packet for each capture, plus a
+	per svc breakdown of time and allocations. Captures are recorded with
+	QWClient::setCaptureFile(). A capture raising parse errors fails the run,
+	so the corpus doubles as a parser regression check.
+
+	Usage: qwbench [-n passes] [-e] [-s] [capture files...]
+	Without files every *.qwcap in the corpus folder next to the binary is used.
+	-e runs the entity store scan benchmark instead.
+	-s runs the spatial index benchmark instead.
+*/
+
+#include "QWClient.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfoList>
+#include <QStringList>
+#include <QVector>
+#include <QtEndian>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//========================================================================
+// Allocation counting, operator new everywhere and malloc where glibc lets the executable interpose it
+
+static quint64 ourAllocations = 0;
+
+#ifdef __GLIBC__
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+
+extern "C" void* malloc(size_t size)
+{
+	ourAllocations++;
+	return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size)
+{
+	ourAllocations++;
+	return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size)
+{
+	if(!ptr)
+		ourAllocations++;
+	return __libc_realloc(ptr, size);
+}
+
+/* Counted by malloc already */
+static void* allocate(size_t size)
+{
+	return __libc_malloc(size ? size : 1);
+}
+#else
+static void* allocate(size_t size)
+{
+	return malloc(size ? size : 1);
+}
+#endif
+
+static void* countedNew(size_t size)
+{
+	ourAllocations++;
+	void* ptr = allocate(size);
+	if(!ptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void* operator new(size_t size)
+{
+	return countedNew(size);
+}
+
+void* operator new[](size_t size)
+{
+	return countedNew(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+void benchEntityStore(int passes);
+void benchSpatialIndex(int passes);
+
+//========================================================================
+
+/* Any error means the parser and the capture disagree, the capture fails */
+class CheckedClient : public QWClient
+{
+public:
+	CheckedClient():
+		errors(0)
+	{}
+
+	int					errors;
+	QByteArray	firstError;
+
+protected:
+	void onError(const char* description)
+	{
+		if(!errors++)
+			firstError = description;
+	}
+};
+
+static bool loadCapture(const QString& fileName, QVector<QByteArray>* datagrams)
+{
+	QFile file(fileName);
+	if(!file.open(QIODevice::ReadOnly))
+		return false;
+
+	QByteArray data = file.readAll();
+	int pos = 0;
+	while(pos + 4 <= data.size())
+	{
+		quint32 size = qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(data.constData() + pos));
+		pos += 4;
+		if(pos + (int)size > data.size())
+			return false;
+		datagrams->append(data.mid(pos, size));
+		pos += size;
+	}
+	return !datagrams->isEmpty();
+}
+
+static void replayAll(QWClient* client, const QVector<QByteArray>& datagrams)
+{
+	for(int i = 0; i < datagrams.size(); ++i)
+		client->replay(datagrams.at(i).constData(), datagrams.at(i).size());
+}
+
+static bool runCapture(const QString& fileName, int passes, const QString& quakeDir)
+{
+	QVector<QByteArray> datagrams;
+	if(!loadCapture(fileName, &datagrams))
+	{
+		fprintf(stderr, "%s: not a valid capture\n", fileName.toLatin1().data());
+		return false;
+	}
+
+	qint64	nsecs = 0;
+	quint64	allocations = 0;
+	quint64	packets = 0;
+
+	/* Timing passes, message timing stays off so it doesn't skew the totals */
+	for(int pass = 0; pass < passes; ++pass)
+	{
+		/* Downloaded files would change what the next pass parses */
+		QDir(quakeDir).removeRecursively();
+		QDir().mkpath(quakeDir);
+
+		QWClient client;
+		client.setQuakeFolder(quakeDir.toLatin1().data());
+
+		QElapsedTimer timer;
+		quint64 allocationsBefore = ourAllocations;
+		timer.start();
+		replayAll(&client, datagrams);
+		nsecs += timer.nsecsElapsed();
+		allocations += ourAllocations - allocationsBefore;
+		packets += datagrams.size();
+	}
+
+	printf("%s\n", fileName.toLatin1().data());
+	printf("  %d datagrams x %d passes\n", datagrams.size(), passes);
+	printf("  %.0f packets/sec  %.0f ns/packet  %.2f allocations/packet\n\n",
+				 packets * 1e9 / qMax<qint64>(nsecs, 1), (double)nsecs / packets, (double)allocations / packets);
+
+	/* One more pass for the per message breakdown */
+	QDir(quakeDir).removeRecursively();
+	QDir().mkpath(quakeDir);
+	CheckedClient client;
+	client.setQuakeFolder(quakeDir.toLatin1().data());
+	client.setMessageTiming();
+	client.setAllocationCounter(&ourAllocations);
+	replayAll(&client, datagrams);
+
+	printf("  %-26s %10s %10s %10s %10s %8s\n", "message", "count", "bytes", "ns/msg", "allocs/msg", "time%");
+	quint64 totalNsecs = 0;
+	for(int svc = 0; svc < 256; ++svc)
+		totalNsecs += client.messageStats(svc).nsecs;
+	for(int svc = 0; svc < 256; ++svc)
+	{
+		const QWClient::MessageStats& stats = client.messageStats(svc);
+		if(!stats.count)
+			continue;
+		printf("  %-26s %10llu %10llu %10.0f %10.2f %7.1f%%\n",
+					 QWClient::messageName(svc),
+					 (unsigned long long)stats.count,
+					 (unsigned long long)stats.bytes,
+					 (double)stats.nsecs / stats.count,
+					 (double)stats.allocations / stats.count,
+					 totalNsecs ? stats.nsecs * 100.0 / totalNsecs : 0.0);
+	}
+	printf("\n");
+
+	if(client.errors)
+	{
+		fprintf(stderr, "%s: %d parse errors, first: %s\n", fileName.toLatin1().data(), client.errors, client.firstError.constData());
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	QCoreApplication app(argc, argv);
+	QStringList args = app.arguments();
+	QStringList captures;
+	int passes = 20;
+	bool entityStore = false;
+	bool spatialIndex = false;
+
+	for(int i = 1; i < args.size(); ++i)
+	{
+		if(args.at(i) == "-n" && i + 1 < args.size())
+			passes = qMax(1, args.at(++i).toInt());
+		else if(args.at(i) == "-e")
+			entityStore = true;
+		else if(args.at(i) == "-s")
+			spatialIndex = true;
+		else
+			captures.append(args.at(i));
+	}
+
+	if(entityStore || spatialIndex)
+	{
+		if(entityStore)
+			benchEntityStore(passes);
+		if(spatialIndex)
+			benchSpatialIndex(passes);
+		return 0;
+	}
+
+	if(captures.isEmpty())
+	{
+		QDir corpus(QCoreApplication::applicationDirPath() + "/corpus");
+		QFileInfoList files = corpus.entryInfoList(QStringList("*.qwcap"), QDir::Files);
+		for(int i = 0; i < files.size(); ++i)
+			captures.append(files.at(i).absoluteFilePath());
+	}
+
+	if(captures.isEmpty())
+	{
+		fprintf(stderr, "usage: qwbench [-n passes] [-e] [-s] [capture files...]\n");
+		return 1;
+	}
+
+	/* Parsing creates the gamedir and may start downloads, keep that out of the way */
+	QString quakeDir = QDir::tempPath() + "/qwbench";
+	QDir().mkpath(quakeDir);
+
+	bool ok = true;
+	for(int i = 0; i < captures.size(); ++i)
+		ok &= runCapture(captures.at(i), passes, quakeDir);
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,21 @@
+#-------------------------------------------------
+#
+# Parser benchmark, replays captured server datagrams
+#
+#-------------------------------------------------
+
+QT       += network
+
+QT       -= gui
+
+TARGET = qwbench
+CONFIG   += console
+CONFIG   -= app_bundle
+TEMPLATE = app
+
+INCLUDEPATH += ..
+LIBS += -L.. -lqwclient
+
+SOURCES += main.cpp \
+    entitystore.cpp \
+    spatialindex.cpp
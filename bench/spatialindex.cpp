@@ -0,0 +1,129 @@
+/*
+GNU General Public License version 3 notice
+
+Copyright (C) 2012 Mihawk <luiz@netdome.biz>. All rights reserved.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see < http://www.gnu.org/licenses/ >.
+*/
+
+/*
+	Every player asks for everything within a radius and for its nearest
+	neighbours, answered by pairwise loops and by QWSpatialIndex. The index
+	is rebuilt every frame as it would be in a live client.
+*/
+
+#include "QWSpatialIndex.h"
+#include <QElapsedTimer>
+#include <QVector>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+
+enum { Players = 32, Entities = 512, Nearest = 4 };
+
+static const float ourRadius = 500.0f;
+
+struct Position
+{
+	float origin[3];
+};
+
+static float distance2(const Position& a, const Position& b)
+{
+	float dx = a.origin[0] - b.origin[0];
+	float dy = a.origin[1] - b.origin[1];
+	float dz = a.origin[2] - b.origin[2];
+	return dx * dx + dy * dy + dz * dz;
+}
+
+static int frameBruteForce(const QVector<Position>& players, const QVector<Position>& entities)
+{
+	float radius2 = ourRadius * ourRadius;
+	float nearest[Players + Entities];
+	int results = 0;
+
+	for(int p = 0; p < players.size(); ++p)
+	{
+		int n = 0;
+		for(int i = 0; i < players.size(); ++i)
+		{
+			float d2 = distance2(players.at(p), players.at(i));
+			results += d2 <= radius2;
+			nearest[n++] = d2;
+		}
+		for(int i = 0; i < entities.size(); ++i)
+		{
+			float d2 = distance2(players.at(p), entities.at(i));
+			results += d2 <= radius2;
+			nearest[n++] = d2;
+		}
+		std::partial_sort(nearest, nearest + Nearest, nearest + n);
+		results += Nearest;
+	}
+	return results;
+}
+
+static int frameIndexed(QWSpatialIndex* index, const QVector<Position>& players, const QVector<Position>& entities)
+{
+	QWSpatialIndex::Hit hits[Players + Entities];
+	int results = 0;
+
+	index->clearEntities();
+	for(int i = 0; i < players.size(); ++i)
+		index->setPlayer(i, players.at(i).origin[0], players.at(i).origin[1], players.at(i).origin[2]);
+	for(int i = 0; i < entities.size(); ++i)
+		index->addEntity(i + 1, entities.at(i).origin[0], entities.at(i).origin[1], entities.at(i).origin[2]);
+
+	for(int p = 0; p < players.size(); ++p)
+	{
+		const float* o = players.at(p).origin;
+		results += index->withinRadius(o[0], o[1], o[2], ourRadius, QWSpatialIndex::Any, hits, Players + Entities);
+		results += index->nearest(o[0], o[1], o[2], Nearest, QWSpatialIndex::Any, hits);
+	}
+	return results;
+}
+
+void benchSpatialIndex(int passes)
+{
+	QVector<Position> players(Players);
+	QVector<Position> entities(Entities);
+	QWSpatialIndex index;
+
+	srand(1);
+	for(int i = 0; i < Players; ++i)
+		for(int j = 0; j < 3; ++j)
+			players[i].origin[j] = (rand() % 4096) - 2048.0f;
+	for(int i = 0; i < Entities; ++i)
+		for(int j = 0; j < 3; ++j)
+			entities[i].origin[j] = (rand() % 4096) - 2048.0f;
+
+	int iterations = passes * 500;
+	QElapsedTimer timer;
+	volatile int sink = 0;
+
+	timer.start();
+	for(int i = 0; i < iterations; ++i)
+		sink += frameBruteForce(players, entities);
+	qint64 bruteNsecs = timer.nsecsElapsed();
+
+	timer.restart();
+	for(int i = 0; i < iterations; ++i)
+		sink += frameIndexed(&index, players, entities);
+	qint64 indexNsecs = timer.nsecsElapsed();
+
+	printf("proximity, %d players x %d entities, radius %.0f and %d nearest per player\n", (int)Players, (int)Entities, ourRadius, (int)Nearest);
+	printf("  pairwise  %10.0f ns/frame\n", (double)bruteNsecs / iterations);
+	printf("  grid      %10.0f ns/frame (rebuild included)\n", (double)indexNsecs / iterations);
+	printf("  results   %d/%d\n\n", frameBruteForce(players, entities), frameIndexed(&index, players, entities));
+}
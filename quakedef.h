@@ -44,6 +44,15 @@ typedef struct
 
 #define MAX_PACKET_ENTITIES	64
 
+#define MAX_CLIENTS		32
+
+#define MAX_CL_STATS	32
+
+#define MAX_EDICTS		2048	// FTE_PEXT_ENTITYDBL2 raises the 512 edict limit to 2048
+
+#define	UPDATE_BACKUP	64	// copies of entity_state_t to keep buffered, must be power of two
+#define	UPDATE_MASK		(UPDATE_BACKUP-1)
+
 typedef struct
 {
 	int						numentities;
@@ -306,5 +315,6 @@ typedef struct
 } dheader_t;
 
 #define MAX_MSGLEN 2048
+#define MAX_UDP_PACKET 8192	// largest datagram we accept from a server
 
 #endif // QUAKEDEF_H
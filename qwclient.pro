@@ -15,12 +15,26 @@ DEFINES += QWCLIENT_LIBRARY
 
 SOURCES += QWClient.cpp \
     QWClientPrivate.cpp \
+    QWClientPool.cpp \
+    QWEntityStore.cpp \
+    QWSpatialIndex.cpp \
+    QWPositionHistory.cpp \
+    QWWorldSnapshot.cpp \
+    QWEventQueue.cpp \
+    QWInfo.cpp \
     QWPack.cpp \
     QWTables.cc
 
 HEADERS += QWClient.h\
         qwclient_global.h \
     QWClientPrivate.h \
+    QWClientPool.h \
+    QWEntityStore.h \
+    QWSpatialIndex.h \
+    QWPositionHistory.h \
+    QWWorldSnapshot.h \
+    QWEventQueue.h \
+    QWInfo.h \
     quakedef.h \
     QWPack.h \
     QWTables.h